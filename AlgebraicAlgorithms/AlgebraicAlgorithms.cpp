@@ -5,6 +5,9 @@
 #include <chrono>
 #include <numeric>
 #include <format>
+#include <random>
+#include <limits>
+#include <ranges>
 
 #include "LogDuration.hpp"
 #include "Tester.hpp"
@@ -13,122 +16,462 @@
 
 using namespace std::chrono;
 
-void TestPow()
+void TestPow(ThreadPool* pool = nullptr, const IsolationLimits* isolation = nullptr)
 {
+    TestSuite suite(pool, isolation);
+    suite.Add(MakeTester<Parse<double>, Parse<uint64_t>>("pow_tests", "Pow Naive",
+        [](double n, uint64_t pow)
+        {
+            return PowNaive(n, pow);
+        }));
+    suite.Add(MakeTester<Parse<double>, Parse<uint64_t>>("pow_tests", "Pow Mult",
+        [](double n, uint64_t pow)
+        {
+            return PowMult(n, pow);
+        }));
+    suite.Add(MakeTester<Parse<double>, Parse<uint64_t>>("pow_tests", "Pow Two Factor",
+        [](double n, uint64_t pow)
+        {
+            return PowTwoFactor(n, pow);
+        }));
+    suite.Run();
+}
+
+void TestFibo(ThreadPool* pool = nullptr, const IsolationLimits* isolation = nullptr)
+{
+    TestSuite suite(pool, isolation);
+    suite.Add(MakeTester<Parse<apa::lint>>("fibo_tests", "Naive Fibo",
+        [](const apa::lint& n)
+        {
+            return FibNaive(n);
+        }));
+    suite.Add(MakeTester<Parse<apa::lint>>("fibo_tests", "Iter Fibo",
+        [](const apa::lint& n)
+        {
+            return FibIter(n);
+        }));
+    suite.Add(MakeTester<Parse<uint64_t>>("fibo_tests", "Matrix Fibo",
+        [](uint64_t n)
+        {
+            return FibMatrix(n);
+        }));
+    suite.Add(MakeTester<Parse<uint64_t>>("fibo_tests", "Fast Doubling Fibo",
+        [](uint64_t n)
+        {
+            return FibFastDoubling(n);
+        }));
+    suite.Add(MakeTester<Parse<uint64_t>>("fibo_tests", "Golden Ratio Fibo",
+        [](uint64_t n)
+        {
+            return FibGoldenRatio(n);
+        }));
+    suite.Run();
+}
+
+void TestSieve(ThreadPool* pool = nullptr, const IsolationLimits* isolation = nullptr)
+{
+    TestSuite suite(pool, isolation);
+    suite.Add(MakeTester<Parse<uint32_t>>("prime_count_tests", "Simple Sieve",
+        [](uint32_t n)
+        {
+            return FindPrimeCountSieve(n);
+        }));
+    suite.Add(MakeTester<Parse<uint32_t>>("prime_count_tests", "Linear Sieve",
+        [](uint32_t n)
+        {
+            return FindPrimeCountSieveLinear(n);
+        }));
+    suite.Add(MakeTester<Parse<uint32_t>>("prime_count_tests", "Sieve Compact",
+        [](uint32_t n)
+        {
+            return FindPrimeCountSieveCompact(n);
+        }));
+    suite.Add(MakeTester<Parse<uint64_t>>("prime_count_tests", "Segmented Sieve",
+        [](uint64_t n)
+        {
+            return FindPrimeCountSieveSegmented(n);
+        }));
+    suite.Add(MakeTester<Parse<uint64_t>>("prime_count_tests", "Wheel Sieve",
+        [](uint64_t n)
+        {
+            return FindPrimeCountSieveWheel(n);
+        }));
+    // The cases share the suite's pool with the sieve's own chunks. A forked
+    // child has no pool threads, so isolated runs start their own pool.
+    ThreadPool* const sieve_pool = isolation == nullptr ? pool : nullptr;
+    suite.Add(MakeTester<Parse<uint64_t>>("prime_count_tests", "Parallel Sieve",
+        [sieve_pool](uint64_t n)
+        {
+            return FindPrimeCountSieveParallel(n, sieve_pool);
+        }));
+    suite.Add(MakeTester<Parse<uint64_t>>("prime_count_tests", "Prime Range",
+        [](uint64_t n)
+        {
+            return std::ranges::distance(PrimeRange(0, n));
+        }));
+    suite.Add(MakeTester<Parse<uint64_t>, Parse<uint64_t>>("prime_range_count_tests", "Prime Count Range",
+        [](uint64_t a, uint64_t b)
+        {
+            return FindPrimeCountRange(a, b);
+        }));
+    suite.Add(MakeTester<Parse<uint64_t>>("cbrt_tests", "Integer Cube Root",
+        [](uint64_t n)
+        {
+            return IntCbrt(n);
+        }));
+    for (std::string folder : { "prime_count_tests", "prime_count_large_tests" })
     {
-        Tester<std::string(std::string, std::string), 2> tester("pow_tests", "Pow Naive",
-            [](std::string arg1, std::string arg2)
+        suite.Add(MakeTester<Parse<uint64_t>>(folder, "Lucy Hedgehog",
+            [](uint64_t n)
             {
-                return std::to_string(PowNaive(std::stod(arg1),
-                    std::stoull(arg2)));
-            });
-        tester.Run();
+                return FindPrimeCountLucy(n);
+            }));
+        suite.Add(MakeTester<Parse<uint64_t>>(folder, "Meissel-Lehmer",
+            [](uint64_t n)
+            {
+                return FindPrimeCountMeisselLehmer(n);
+            }));
+    }
+    suite.Add(MakeTester<Parse<uint32_t>>("totient_sum_tests", "Totient Table",
+        [](uint32_t n)
+        {
+            std::vector<uint32_t> phi(n + 1);
+            FillMultiplicativeTables(n, { .phi = phi });
+            return std::accumulate(phi.begin(), phi.end(), uint64_t(0));
+        }));
+    suite.Add(MakeTester<Parse<uint32_t>>("mertens_tests", "Moebius Table",
+        [](uint32_t n)
+        {
+            std::vector<int8_t> mu(n + 1);
+            FillMultiplicativeTables(n, { .mu = mu });
+            return std::accumulate(mu.begin(), mu.end(), int64_t(0));
+        }));
+    suite.Run();
+}
+
+// 10^4 random pi(n) queries below 10^9 in one batch, against answering the
+// first 10 of them one sieve each.
+void BenchPrimeCountMany()
+{
+    std::mt19937_64 gen(2024);
+    std::vector<uint64_t> queries(10'000);
+    for (uint64_t& n : queries)
+    {
+        n = gen() % 1'000'000'000;
     }
+
+    std::vector<uint64_t> batch;
     {
-        Tester<std::string(std::string, std::string), 2> tester("pow_tests", "Pow Mult",
-            [](std::string arg1, std::string arg2)
-            {
-                return std::to_string(PowMult(std::stod(arg1),
-                    std::stoull(arg2)));
-            });
-        tester.Run();
+        LOG_DURATION("FindPrimeCountMany, 10^4 queries");
+        batch = FindPrimeCountMany(queries);
     }
+    size_t mismatches = 0;
     {
-        Tester<std::string(std::string, std::string),2> tester("pow_tests", "Pow Two Factor", 
-            [](std::string arg1, std::string arg2)
-            {
-                return std::to_string(PowTwoFactor(std::stod(arg1),
-                    std::stoull(arg2)));
-            });
-        tester.Run();
+        LOG_DURATION("FindPrimeCountSieveSegmented, 10 queries");
+        for (size_t i = 0; i < 10; ++i)
+        {
+            mismatches += FindPrimeCountSieveSegmented(queries[i]) != batch[i];
+        }
     }
+    std::cout << mismatches << " mismatches" << std::endl;
 }
 
-void TestFibo()
+// Miller-Rabin on a million random odd 64-bit numbers, one call per
+// number against the batch API.
+void BenchIsPrime()
 {
+    std::mt19937_64 gen(2024);
+    std::vector<uint64_t> values(1'000'000);
+    for (uint64_t& value : values)
     {
-        Tester<std::string(std::string), 1> tester("fibo_tests", "Naive Fibo",
-            [](std::string str)
-            {
-                return FibNaive(apa::lint(str)).to_string();
-            });
-        tester.Run();
+        value = gen() | 1;
     }
+
+    size_t single = 0, batch = 0;
+    {
+        LOG_DURATION("IsPrimeMillerRabin x 10^6");
+        for (uint64_t value : values)
+        {
+            single += IsPrimeMillerRabin(value);
+        }
+    }
+    {
+        LOG_DURATION("IsPrimeMany x 10^6");
+        for (uint8_t prime : IsPrimeMany(values))
+        {
+            batch += prime;
+        }
+    }
+    std::cout << single << " / " << batch << " primes" << std::endl;
+}
+
+// Parallel sieve timings for 1, 2, 4, ... threads up to the core count.
+void BenchSieveParallel(uint64_t n = 10'000'000'000)
+{
+    const size_t cores = ThreadPool::DefaultThreadCount();
+    double single = 0;
+    std::cout << "threads\tms\tspeedup (pi(" << n << "))" << std::endl;
+    for (size_t threads = 1; ; threads = std::min(threads * 2, cores))
     {
+        ThreadPool pool(threads);
+        const auto start = steady_clock::now();
+        const uint64_t count = FindPrimeCountSieveParallel(n, &pool);
+        const double ms = duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.;
+        if (threads == 1)
+        {
+            single = ms;
+        }
+        std::cout << threads << '\t' << ms << '\t' << single / ms << "\t(" << count << ')' << std::endl;
+        if (threads == cores)
+        {
+            break;
+        }
+    }
+}
 
-        Tester<std::string(std::string), 1> tester("fibo_tests", "Iter Fibo",
-            [](std::string str)
+
+// Nanosecond timings of the cases that Tester::Run reports as 0 ms.
+void BenchFastCases()
+{
+    {
+        auto tester = MakeTester<Parse<double>, Parse<uint64_t>>("pow_tests", "Pow Two Factor",
+            [](double n, uint64_t pow)
             {
-                return FibIter(apa::lint(str)).to_string();
+                return PowTwoFactor(n, pow);
             });
-        tester.Run();
+        tester.Benchmark();
     }
     {
-        Tester<std::string(std::string), 1> tester("fibo_tests", "Matrix Fibo",
-            [](std::string str)
+        auto tester = MakeTester<Parse<uint64_t>>("fibo_tests", "Matrix Fibo",
+            [](uint64_t n)
             {
-                return std::to_string(FibMatrix(strtoull(str.data(), NULL, 10)));
+                return FibMatrix(n);
             });
-        tester.Run();
+        tester.Benchmark();
     }
     {
-        Tester<std::string(std::string), 1> tester("fibo_tests", "Golden Ratio Fibo",
-            [](std::string str)
+        auto tester = MakeTester<Parse<uint64_t>>("fibo_tests", "Golden Ratio Fibo",
+            [](uint64_t n)
             {
-                return std::to_string(FibGoldenRatio(stoull(str)));
+                return FibGoldenRatio(n);
             });
-        tester.Run();
+        tester.Benchmark();
     }
 }
 
-void TestSieve()
+apa::lint RandomLint(size_t digits, std::mt19937& gen)
 {
+    std::uniform_int_distribution<int> digit(0, 9);
+    std::string str(digits, '0');
+    for (char& c : str)
     {
-        Tester<std::string(std::string), 1> tester("prime_count_tests", "Simple Sieve", 
-            [](std::string str)
-            {
-                return std::to_string(FindPrimeCountSieve(strtoul(str.data(), NULL, 10)));
-            });
-        tester.Run();
+        c = static_cast<char>('0' + digit(gen));
+    }
+    str[0] = static_cast<char>('1' + digit(gen) % 9);
+    return apa::lint(str);
+}
+
+// Microseconds per a * b, repeated until at least 50 ms have passed.
+double TimeLintMul(const apa::lint& a, const apa::lint& b)
+{
+    size_t reps = 0;
+    const auto start = steady_clock::now();
+    auto elapsed = steady_clock::now() - start;
+    while (elapsed < 50ms)
+    {
+        apa::lint c = a * b;
+        ++reps;
+        elapsed = steady_clock::now() - start;
     }
+    return duration_cast<nanoseconds>(elapsed).count() / 1000. / reps;
+}
+
+// Prints per-size timings to locate the multiplication crossovers:
+// Karatsuba should be tuned to where "karatsuba x1" (one level over
+// schoolbook) beats "schoolbook", Toom-3 to where "toom3 x1" (one level over
+// the recursive Karatsuba) beats "karatsuba", and the NTT to where "ntt"
+// beats the best of the others.
+void BenchLintMul()
+{
+    const size_t karatsuba_threshold = apa::lint::karatsuba_threshold;
+    const size_t toom3_threshold = apa::lint::toom3_threshold;
+    const size_t ntt_threshold = apa::lint::ntt_threshold;
+    const size_t never = std::numeric_limits<size_t>::max();
+    std::mt19937 gen(2024);
+
+    apa::lint::ntt_threshold = never;
+    std::cout << "limbs\tschoolbook\tkaratsuba x1\tkaratsuba\ttoom3 x1\tntt (us per mul)" << std::endl;
+    for (size_t limbs = 8; limbs <= 4096; limbs *= 2)
     {
+        apa::lint a = RandomLint(limbs * apa::lint::BASE_DIGITS, gen);
+        apa::lint b = RandomLint(limbs * apa::lint::BASE_DIGITS, gen);
 
-        Tester<std::string(std::string), 1> tester("prime_count_tests", "Linear Sieve",
-            [](std::string str)
-            {
-                return std::to_string(FindPrimeCountSieveLinear(strtoul(str.data(), NULL, 10)));
-            });
-        tester.Run();
+        apa::lint::karatsuba_threshold = never;
+        apa::lint::toom3_threshold = never;
+        double schoolbook = TimeLintMul(a, b);
+
+        apa::lint::karatsuba_threshold = limbs;
+        double karatsuba_one_level = TimeLintMul(a, b);
+
+        apa::lint::karatsuba_threshold = karatsuba_threshold;
+        double karatsuba = TimeLintMul(a, b);
+
+        std::cout << limbs << '\t' << schoolbook << '\t' << karatsuba_one_level << '\t' << karatsuba << '\t';
+        if (limbs >= karatsuba_threshold)
+        {
+            apa::lint::toom3_threshold = limbs;
+            std::cout << TimeLintMul(a, b);
+        }
+        else
+        {
+            std::cout << '-';
+        }
+
+        apa::lint::toom3_threshold = toom3_threshold;
+        apa::lint::ntt_threshold = limbs;
+        std::cout << '\t' << TimeLintMul(a, b) << std::endl;
+        apa::lint::ntt_threshold = never;
+    }
+
+    apa::lint::karatsuba_threshold = karatsuba_threshold;
+    apa::lint::toom3_threshold = toom3_threshold;
+    apa::lint::ntt_threshold = ntt_threshold;
+}
+
+// FibNaive makes about F(n) calls on one-limb lints, so it mostly measures
+// how cheaply small lints are created, added and destroyed.
+void BenchFibNaive()
+{
+    for (int n = 25; n <= 35; n += 5)
+    {
+        LOG_DURATION("FibNaive(" + std::to_string(n) + ")");
+        FibNaive(n);
     }
+}
+
+// Milliseconds per call of f, repeated for at least 200 ms.
+template <typename F>
+double TimeMs(F f)
+{
+    size_t reps = 0;
+    const auto start = steady_clock::now();
+    auto elapsed = steady_clock::now() - start;
+    while (elapsed < 200ms)
     {
-        Tester<std::string(std::string), 1> tester("prime_count_tests", "Sieve Compact", 
-            [](std::string str)
+        f();
+        ++reps;
+        elapsed = steady_clock::now() - start;
+    }
+    return duration_cast<microseconds>(elapsed).count() / 1000. / reps;
+}
+
+// Compares the plain i-j-k product with the blocked Matrix<T>::Multiply,
+// single threaded and spread over a pool of all hardware threads.
+template <typename T>
+void BenchMatrixMulOf(const std::string& type_name, ThreadPool& pool)
+{
+    std::mt19937 gen(2024);
+    for (size_t n : { 64, 256, 1024 })
+    {
+        Matrix<T> a(n), b(n), c(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < n; ++j)
             {
-                return std::to_string(FindPrimeCountSieveCompact(strtoul(str.data(), NULL, 10)));
+                a[i][j] = static_cast<T>(gen() % 1000);
+                b[i][j] = static_cast<T>(gen() % 1000);
+            }
+        }
+
+        double naive = TimeMs([&]
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    for (size_t j = 0; j < n; ++j)
+                    {
+                        T cur = 0;
+                        for (size_t k = 0; k < n; ++k)
+                        {
+                            cur += a[i][k] * b[k][j];
+                        }
+                        c[i][j] = cur;
+                    }
+                }
             });
-        tester.Run();
+        double blocked = TimeMs([&] { Matrix<T>::Multiply(a, b, c); });
+        double threaded = TimeMs([&] { Matrix<T>::Multiply(a, b, c, &pool); });
+        std::cout << type_name << '\t' << n << '\t' << naive << '\t' << blocked << '\t' << threaded << std::endl;
     }
 }
 
+void BenchMatrixMul()
+{
+    ThreadPool pool;
+    std::cout << "type\tsize\tnaive\tblocked\tblocked x" << pool.GetThreadCount() << " threads (ms per mul)" << std::endl;
+    BenchMatrixMulOf<double>("double", pool);
+    BenchMatrixMulOf<uint64_t>("uint64", pool);
+}
 
 int main()
 {
     std::ofstream out;
 
+    // Test cases and their variants run side by side on this pool. Set
+    // EXCLUSIVE_TESTS to run them one at a time when the timings matter.
+    constexpr bool EXCLUSIVE_TESTS = false;
+    ThreadPool pool;
+    ThreadPool* const tests_pool = EXCLUSIVE_TESTS ? nullptr : &pool;
+    // Timings of the sieve, lint and matrix kernels against their slower
+    // variants, on top of the tests
+    constexpr bool RUN_BENCHMARKS = false;
+    // Cases that may hang or run out of memory go to child processes with
+    // these limits (Linux), with their peak RSS reported
+    [[maybe_unused]] const IsolationLimits isolation{ .timeout = 30s, .memory_limit = uint64_t(4) << 30 };
+
     std::cout << "============================================" << std::endl;
     std::cout << "\t\t\t\tPOW\t\t\t\t" << std::endl;
     std::cout << "============================================" << std::endl;
-    //TestPow();
+    //TestPow(nullptr, &isolation);
 
     std::cout << "============================================" << std::endl;
     std::cout << "\t\t\t\tSIEVE\t\t\t\t" << std::endl;
     std::cout << "============================================" << std::endl;
-    TestSieve();
+    TestSieve(tests_pool);
+    if constexpr (RUN_BENCHMARKS)
+    {
+        BenchSieveParallel();
+        BenchIsPrime();
+        BenchPrimeCountMany();
+    }
 
     std::cout << "============================================" << std::endl;
     std::cout << "\t\t\t\tFIBO\t\t\t\t" << std::endl;
     std::cout << "============================================" << std::endl;
-    TestFibo();
+    TestFibo(tests_pool);
+
+    if constexpr (RUN_BENCHMARKS)
+    {
+        std::cout << "============================================" << std::endl;
+        std::cout << "\t\t\t\tLINT MUL\t\t\t\t" << std::endl;
+        std::cout << "============================================" << std::endl;
+        BenchLintMul();
+        BenchFibNaive();
+        BenchFastCases();
+
+        std::cout << "============================================" << std::endl;
+        std::cout << "\t\t\t\tMATRIX MUL\t\t\t\t" << std::endl;
+        std::cout << "============================================" << std::endl;
+        BenchMatrixMul();
+    }
+
+#ifdef PROFILE_ZONES
+    std::cout << "============================================" << std::endl;
+    std::cout << "\t\t\t\tPROFILE\t\t\t\t" << std::endl;
+    std::cout << "============================================" << std::endl;
+    Profiler::Get().Report(std::cout);
+    std::ofstream trace("trace.json");
+    Profiler::Get().ExportChromeTrace(trace);
+#endif
 
     std::cin >> std::ws;
     std::cin.get();
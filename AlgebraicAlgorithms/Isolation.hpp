@@ -0,0 +1,254 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+struct IsolationLimits
+{
+    // Wall-clock time from fork to the result
+    std::chrono::milliseconds timeout = std::chrono::seconds(10);
+    // RLIMIT_AS of the child in bytes, 0 for none. It covers the whole
+    // address space, the mappings inherited from the parent included.
+    uint64_t memory_limit = 0;
+};
+
+struct IsolatedRun
+{
+    enum class Status
+    {
+        OK,
+        TIMEOUT,
+        // std::bad_alloc in the child, or killed by the kernel's OOM killer
+        OOM,
+        // any other signal or exception
+        CRASHED
+    };
+
+    Status status = Status::OK;
+    // What the call returned if OK, the exception text if it threw
+    std::string output;
+    // Of the call alone if OK, fork to kill or exit otherwise
+    std::chrono::nanoseconds duration{ 0 };
+    uint64_t peak_rss = 0;
+    int signal = 0;
+};
+
+inline const char* ToString(IsolatedRun::Status status)
+{
+    switch (status)
+    {
+    case IsolatedRun::Status::OK:
+        return "OK";
+    case IsolatedRun::Status::TIMEOUT:
+        return "TIMEOUT";
+    case IsolatedRun::Status::OOM:
+        return "OOM";
+    default:
+        return "CRASHED";
+    }
+}
+
+#ifdef __linux__
+
+// Runs call in a forked child process under limits. call returns its
+// result as text and sets the duration of the work itself, formatting
+// left out. The child sends both back through a pipe; the parent
+// kills it with SIGKILL once limits.timeout has passed and takes its peak
+// RSS from wait4. Forking copies only the calling thread, so the call
+// must not need other threads of the parent, and no other thread should
+// be inside malloc or hold a lock the call takes meanwhile.
+inline IsolatedRun RunIsolated(const std::function<std::string(std::chrono::nanoseconds&)>& call, const IsolationLimits& limits)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr int EXIT_OOM = 3;
+    constexpr int EXIT_EXCEPTION = 4;
+
+    IsolatedRun run;
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        run.status = IsolatedRun::Status::CRASHED;
+        run.output = std::string("pipe: ") + std::strerror(errno);
+        return run;
+    }
+
+    // Or the child would print the parent's pending output a second time
+    std::cout.flush();
+    std::cerr.flush();
+    const auto start = Clock::now();
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        run.status = IsolatedRun::Status::CRASHED;
+        run.output = std::string("fork: ") + std::strerror(errno);
+        return run;
+    }
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+        if (limits.memory_limit != 0)
+        {
+            const rlimit limit{ limits.memory_limit, limits.memory_limit };
+            setrlimit(RLIMIT_AS, &limit);
+        }
+
+        int code = 0;
+        std::string message;
+        std::chrono::nanoseconds duration{ 0 };
+        try
+        {
+            message = call(duration);
+        }
+        catch (const std::bad_alloc&)
+        {
+            code = EXIT_OOM;
+        }
+        catch (const std::exception& e)
+        {
+            code = EXIT_EXCEPTION;
+            message = e.what();
+        }
+        catch (...)
+        {
+            code = EXIT_EXCEPTION;
+        }
+
+        // An 8-byte duration, then the message
+        const int64_t ns = duration.count();
+        std::string data(sizeof(ns), '\0');
+        std::memcpy(data.data(), &ns, sizeof(ns));
+        data += message;
+        for (size_t sent = 0; sent < data.size();)
+        {
+            const ssize_t n = write(fds[1], data.data() + sent, data.size() - sent);
+            if (n <= 0)
+            {
+                break;
+            }
+            sent += n;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        _exit(code);
+    }
+
+    close(fds[1]);
+    std::string data;
+    bool timed_out = false;
+    const auto deadline = start + limits.timeout;
+    pollfd poll_fd{ fds[0], POLLIN, 0 };
+    char buffer[4096];
+    while (true)
+    {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (left <= 0)
+        {
+            timed_out = true;
+            break;
+        }
+        const int ready = poll(&poll_fd, 1, static_cast<int>(left));
+        if (ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ready == 0)
+        {
+            timed_out = true;
+            break;
+        }
+        const ssize_t n = read(fds[0], buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        data.append(buffer, n);
+    }
+    if (timed_out)
+    {
+        kill(pid, SIGKILL);
+    }
+    close(fds[0]);
+
+    int status = 0;
+    rusage usage{};
+    while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR)
+    {
+    }
+    run.duration = Clock::now() - start;
+    // ru_maxrss is in kilobytes on Linux
+    run.peak_rss = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+
+    if (timed_out)
+    {
+        run.status = IsolatedRun::Status::TIMEOUT;
+    }
+    else if (WIFSIGNALED(status))
+    {
+        run.signal = WTERMSIG(status);
+        // Nobody but the OOM killer sends a SIGKILL here
+        run.status = run.signal == SIGKILL ? IsolatedRun::Status::OOM : IsolatedRun::Status::CRASHED;
+    }
+    else if (WEXITSTATUS(status) == EXIT_OOM)
+    {
+        run.status = IsolatedRun::Status::OOM;
+    }
+    else if (WEXITSTATUS(status) != 0 || data.size() < sizeof(int64_t))
+    {
+        run.status = IsolatedRun::Status::CRASHED;
+        run.output = data.size() > sizeof(int64_t) ? data.substr(sizeof(int64_t)) : std::string();
+    }
+    else
+    {
+        int64_t ns = 0;
+        std::memcpy(&ns, data.data(), sizeof(ns));
+        run.duration = std::chrono::nanoseconds(ns);
+        run.output = data.substr(sizeof(ns));
+    }
+    return run;
+}
+
+#else
+
+// No fork elsewhere: the call runs in this process, unbounded, and no
+// peak RSS is measured.
+inline IsolatedRun RunIsolated(const std::function<std::string(std::chrono::nanoseconds&)>& call, const IsolationLimits&)
+{
+    IsolatedRun run;
+    try
+    {
+        run.output = call(run.duration);
+    }
+    catch (const std::bad_alloc&)
+    {
+        run.status = IsolatedRun::Status::OOM;
+    }
+    catch (const std::exception& e)
+    {
+        run.status = IsolatedRun::Status::CRASHED;
+        run.output = e.what();
+    }
+    return run;
+}
+
+#endif
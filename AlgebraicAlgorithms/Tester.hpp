@@ -6,13 +6,26 @@
 #include <regex>
 #include <filesystem>
 #include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <fstream>
 #include <numeric>
 #include <algorithm>
 #include <optional>
 #include <cmath>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <format>
+#include <iomanip>
+#include <exception>
+#include <sstream>
 
 #include "lint.hpp"
+#include "ThreadPool.hpp"
+#include "LogDuration.hpp"
+#include "Isolation.hpp"
 
 namespace fs = std::filesystem;
 using namespace std::literals;
@@ -27,73 +40,328 @@ std::ostream& operator<<(std::ostream& out, const std::vector<T>& v)
     return out;
 }
 
-template <typename F, int ARGNUM>
+// Keeps the compiler from dropping a computation whose result is unused:
+// value counts as read and all memory as possibly changed.
+template <typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static const void* volatile sink;
+    sink = &value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct BenchmarkOptions
+{
+    // Untimed calls before measuring
+    size_t warmup = 1;
+    // Timing stops after max_iterations calls or once time_budget has
+    // passed, whichever comes first; at least one sample is always taken
+    size_t max_iterations = 10'000'000;
+    std::chrono::nanoseconds time_budget = std::chrono::milliseconds(200);
+    // Calls are timed in batches lasting at least this long, so that the
+    // cost of reading the clock is negligible next to them
+    std::chrono::nanoseconds min_sample_time = std::chrono::microseconds(10);
+};
+
+// Nanoseconds per call. Each sample is the mean over one batch of calls.
+struct BenchmarkStats
+{
+    size_t iterations = 0;
+    size_t samples = 0;
+    double min_ns = 0;
+    double median_ns = 0;
+    double mean_ns = 0;
+    double p99_ns = 0;
+
+    double CallsPerSecond() const
+    {
+        return mean_ns > 0 ? 1e9 / mean_ns : 0;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const BenchmarkStats& stats)
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1)
+        << "min " << stats.min_ns << " ns, median " << stats.median_ns << " ns, mean " << stats.mean_ns
+        << " ns, p99 " << stats.p99_ns << " ns, " << std::defaultfloat << std::setprecision(4)
+        << stats.CallsPerSecond() << " calls/s (" << stats.iterations << " calls in " << stats.samples << " samples)";
+    return out << ss.str();
+}
+
+// Calls f repeatedly as options say and returns the distribution of its
+// running time. The batch size doubles from 1 until a batch takes
+// options.min_sample_time, those calibration calls are not counted.
+template <typename F>
+BenchmarkStats Measure(F&& f, const BenchmarkOptions& options = {})
+{
+    using Clock = std::chrono::steady_clock;
+    auto call = [&f]
+    {
+        if constexpr (std::is_void_v<decltype(f())>)
+        {
+            f();
+            DoNotOptimize(f);
+        }
+        else
+        {
+            DoNotOptimize(f());
+        }
+    };
+    auto time_batch = [&call](size_t batch)
+    {
+        const auto start = Clock::now();
+        for (size_t i = 0; i < batch; ++i)
+        {
+            call();
+        }
+        return Clock::now() - start;
+    };
+
+    for (size_t i = 0; i < options.warmup; ++i)
+    {
+        call();
+    }
+    size_t batch = 1;
+    while (batch < options.max_iterations && time_batch(batch) < options.min_sample_time)
+    {
+        batch *= 2;
+    }
+    batch = std::min(batch, std::max<size_t>(options.max_iterations, 1));
+
+    std::vector<double> samples;
+    BenchmarkStats stats;
+    const auto start = Clock::now();
+    do
+    {
+        const auto elapsed = time_batch(batch);
+        samples.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / batch);
+        stats.iterations += batch;
+    } while (stats.iterations + batch <= options.max_iterations && Clock::now() - start < options.time_budget);
+
+    std::sort(samples.begin(), samples.end());
+    stats.samples = samples.size();
+    stats.min_ns = samples.front();
+    stats.median_ns = samples[samples.size() / 2];
+    stats.p99_ns = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    double total = 0;
+    for (double sample : samples)
+    {
+        total += sample;
+    }
+    stats.mean_ns = total / samples.size();
+    return stats;
+}
+
+// Parsers of one line of a .in file into an argument of the tested
+// function, picked per argument: MakeTester<Parse<double>, Parse<uint64_t>>.
+// Any default-constructible type callable on a std::string will do.
+template <typename T>
+struct Parse;
+
+template <>
+struct Parse<std::string>
+{
+    const std::string& operator()(const std::string& str) const
+    {
+        return str;
+    }
+};
+
+template <>
+struct Parse<double>
+{
+    double operator()(const std::string& str) const
+    {
+        return std::stod(str);
+    }
+};
+
+template <>
+struct Parse<uint32_t>
+{
+    uint32_t operator()(const std::string& str) const
+    {
+        return static_cast<uint32_t>(std::stoul(str));
+    }
+};
+
+template <>
+struct Parse<uint64_t>
+{
+    uint64_t operator()(const std::string& str) const
+    {
+        return std::stoull(str);
+    }
+};
+
+template <>
+struct Parse<apa::lint>
+{
+    apa::lint operator()(const std::string& str) const
+    {
+        return apa::lint(str);
+    }
+};
+
+// Text of a result, compared against the .out file
+inline std::string FormatResult(const std::string& value)
+{
+    return value;
+}
+
+inline std::string FormatResult(const apa::lint& value)
+{
+    return value.to_string();
+}
+
+template <typename T>
+    requires std::is_arithmetic_v<T>
+std::string FormatResult(T value)
+{
+    return std::to_string(value);
+}
+
+// Runs function on the test cases of folder: line i of every .in file is
+// read with the i-th parser, the result is formatted and compared with
+// the .out file. Only the call itself is timed. Made by MakeTester, which
+// deduces F.
+template <typename F, typename... Parsers>
 class Tester
 {
 public:
 
     Tester(const std::string& folder, const std::string& function_name, 
-           std::function<F> function, std::ostream& out_info = std::cout)
-        : folder_(folder), function_name_(function_name), function_(function), out_info_(out_info)
+           F function, std::ostream& out_info = std::cout)
+        : folder_(folder), function_name_(function_name), function_(std::move(function)), out_info_(out_info)
     {
 
     }
 
-    void Run()
+    // Checks every case and writes the report to out. With a pool the
+    // cases run side by side and their reports are written in the usual
+    // order once all are done; durations then include the contention, so
+    // leave pool null when the timings matter.
+    void Run(std::ostream& out, ThreadPool* pool = nullptr)
     {
-        std::set<fs::path, AlphaNumSort> files;
-        for (const auto& file : fs::directory_iterator(fs::path(folder_)))
+        const auto sorted = CollectFiles();
+        const std::vector<fs::path> files(sorted.begin(), sorted.end());
+        if (pool == nullptr)
         {
-            std::string in_filename = file.path().string();
-            if (file.path().filename().string().find(in_ext_) != std::string::npos)
+            for (const auto& file : files)
             {
-                files.insert(file);
+                RunCase(file, out);
             }
-            
+            return;
+        }
+
+        std::vector<std::string> reports(files.size());
+        pool->ParallelFor(0, files.size(), [&](size_t i)
+            {
+                std::stringstream report;
+                RunCase(files[i], report);
+                reports[i] = report.str();
+            });
+        for (const auto& report : reports)
+        {
+            out << report;
         }
-        for (const auto& file : files)
+        out.flush();
+    }
+
+    void Run(ThreadPool* pool = nullptr)
+    {
+        Run(out_info_, pool);
+    }
+
+    // Every case in a child process of its own, one at a time (see
+    // ::RunIsolated). A case over limits.timeout or limits.memory_limit
+    // is reported as TIMEOUT or OOM instead of stalling or ending the run,
+    // and every duration comes with the child's peak RSS.
+    void RunIsolated(std::ostream& out, const IsolationLimits& limits)
+    {
+        for (const auto& file : CollectFiles())
         {
+            std::vector<std::string> args = ReadArgs(file);
+            if (!HasAllArgs(file, args, out))
             {
-                std::ifstream in_file(file.string());
-                std::vector<std::string> args;
-                std::string in_line;
-                while (getline(in_file, in_line))
+                out << "=======================================================\n\n";
+                continue;
+            }
+            const auto parsed = ParseArgs(args);
+            const IsolatedRun run = ::RunIsolated([&](std::chrono::nanoseconds& duration)
                 {
-                    args.push_back(in_line);
-                }
+                    const auto start = std::chrono::steady_clock::now();
+                    Result value = std::apply(function_, parsed);
+                    duration = std::chrono::steady_clock::now() - start;
+                    return FormatResult(value);
+                }, limits);
 
-                std::string out_filename = folder_ + "\\" + file.stem().string() + out_ext_;
-                std::ifstream out_file(out_filename);
-                std::string out_line;
-                getline(out_file, out_line);
-                std::string result;
-                {
-                    std::stringstream ss; ss << args;
-                    LOG_DURATION(std::format("{} FOR INPUT = ", function_name_) + ss.str() + "\n");
-                    if constexpr (ARGNUM == 0)
-                        result = function_();
-                    else if constexpr (ARGNUM == 1)
-                        result = function_(args[0]);
-                    else if constexpr (ARGNUM == 2)
-                        result = function_(args[0], args[1]);
-                    else
-                    {
-                        std::cerr << "Unsupported number of arguments" << std::endl;
-                    }
-                }
-                if (CheckResult(result, out_line))
+            std::stringstream ss; ss << args;
+            out << function_name_ << " FOR INPUT = " << ss.str() << "\n: ";
+            if (run.status != IsolatedRun::Status::OK)
+            {
+                out << ToString(run.status) << " after ";
+            }
+            out << std::chrono::duration_cast<std::chrono::milliseconds>(run.duration).count() << " ms, peak RSS "
+                << std::fixed << std::setprecision(1) << run.peak_rss / (1024. * 1024.) << std::defaultfloat << " MB" << std::endl;
+
+            if (run.status == IsolatedRun::Status::OK && CheckResult(run.output, ReadExpected(file)))
+            {
+                out << file.filename() << ": " << "PASSED" << std::endl;
+            }
+            else if (run.status == IsolatedRun::Status::OK)
+            {
+                ReportFailure(file, args, run.output, out);
+            }
+            else
+            {
+                out << file.filename() << ": " << ToString(run.status);
+                if (run.signal != 0)
                 {
-                    std::cout << file.filename() << ": " << "PASSED" << std::endl;
-                    //std::cout << "\tExpected: " << out_line << "\n\tResult: " << result << std::endl << std::endl;
+                    out << " (signal " << run.signal << ")";
                 }
-                else
+                if (!run.output.empty())
                 {
-                    std::cout << file.filename() << ": " << "FAILED" << std::endl;
-                    std::cout << "\tINPUT: " << in_line << std::endl;
-                    std::cout << '\t' /* << "SHOULD BE: " << out_line */ << "\n\tRESULT: " << result << std::endl << std::endl;
+                    out << ": " << run.output;
                 }
-                std::cout << "=======================================================\n\n";
+                out << std::endl;
+            }
+            out << "=======================================================\n\n";
+        }
+    }
+
+    void RunIsolated(const IsolationLimits& limits)
+    {
+        RunIsolated(out_info_, limits);
+    }
+
+    // Statistical timing of every test case for functions too fast to show
+    // up in Run's milliseconds. A case is checked once and then measured
+    // with Measure().
+    void Benchmark(const BenchmarkOptions& options = {})
+    {
+        for (const auto& file : CollectFiles())
+        {
+            std::vector<std::string> args = ReadArgs(file);
+            if (!HasAllArgs(file, args, out_info_))
+            {
+                continue;
             }
+            const auto parsed = ParseArgs(args);
+            std::string result = FormatResult(std::apply(function_, parsed));
+            if (!CheckResult(result, ReadExpected(file)))
+            {
+                ReportFailure(file, args, result, out_info_);
+                continue;
+            }
+            const BenchmarkStats stats = Measure([&] { return std::apply(function_, parsed); }, options);
+            std::stringstream ss; ss << args;
+            out_info_ << function_name_ << " FOR INPUT = " << ss.str() << "\n: " << stats << std::endl;
         }
     }
 
@@ -105,7 +373,7 @@ public:
         {
             double dres = stod(res);
             double dtarget = stod(target);
-            return (abs(dres - dtarget) < EPS);
+            return (std::abs(dres - dtarget) < EPS);
         }
         catch (...)
         {
@@ -117,6 +385,70 @@ public:
 
 private:
 
+    using Result = std::decay_t<std::invoke_result_t<F&, std::invoke_result_t<Parsers, const std::string&>...>>;
+
+    // Arguments by value, so that no parsing is left for the timed call
+    auto ParseArgs(const std::vector<std::string>& args) const
+    {
+        return ParseArgs(args, std::index_sequence_for<Parsers...>{});
+    }
+
+    template <size_t... I>
+    auto ParseArgs(const std::vector<std::string>& args, std::index_sequence<I...>) const
+    {
+        return std::tuple<std::decay_t<std::invoke_result_t<Parsers, const std::string&>>...>(Parsers{}(args[I])...);
+    }
+
+    void RunCase(const fs::path& file, std::ostream& out)
+    {
+        std::vector<std::string> args = ReadArgs(file);
+        if (!HasAllArgs(file, args, out))
+        {
+            out << "=======================================================\n\n";
+            return;
+        }
+        std::string out_line = ReadExpected(file);
+        const auto parsed = ParseArgs(args);
+        std::stringstream ss; ss << args;
+        std::optional<Result> value;
+        {
+            LogDuration duration(std::format("{} FOR INPUT = ", function_name_) + ss.str() + "\n", out);
+            value.emplace(std::apply(function_, parsed));
+        }
+        std::string result = FormatResult(*value);
+        if (CheckResult(result, out_line))
+        {
+            out << file.filename() << ": " << "PASSED" << std::endl;
+            //out << "\tExpected: " << out_line << "\n\tResult: " << result << std::endl << std::endl;
+        }
+        else
+        {
+            ReportFailure(file, args, result, out);
+        }
+        out << "=======================================================\n\n";
+    }
+
+    // A .in file with fewer lines than parsers is reported as failed
+    // instead of being parsed
+    bool HasAllArgs(const fs::path& file, const std::vector<std::string>& args, std::ostream& out) const
+    {
+        if (args.size() >= sizeof...(Parsers))
+        {
+            return true;
+        }
+        out << file.filename() << ": " << "FAILED" << std::endl;
+        out << "\tINPUT: " << args << std::endl;
+        out << "\tEXPECTED " << sizeof...(Parsers) << " ARGUMENTS, GOT " << args.size() << std::endl << std::endl;
+        return false;
+    }
+
+    void ReportFailure(const fs::path& file, const std::vector<std::string>& args, const std::string& result, std::ostream& out)
+    {
+        out << file.filename() << ": " << "FAILED" << std::endl;
+        out << "\tINPUT: " << args << std::endl;
+        out << '\t' /* << "SHOULD BE: " << out_line */ << "\n\tRESULT: " << result << std::endl << std::endl;
+    }
+
     struct AlphaNumSort
     {
         std::optional<int> GetFirstNumber(const std::string& s) const
@@ -140,12 +472,160 @@ private:
         }
     };
 
+    std::set<fs::path, AlphaNumSort> CollectFiles() const
+    {
+        std::set<fs::path, AlphaNumSort> files;
+        for (const auto& file : fs::directory_iterator(fs::path(folder_)))
+        {
+            if (file.path().filename().string().find(in_ext_) != std::string::npos)
+            {
+                files.insert(file);
+            }
+        }
+        return files;
+    }
+
+    // One argument per line of the .in file
+    std::vector<std::string> ReadArgs(const fs::path& file) const
+    {
+        std::ifstream in_file(file.string());
+        std::vector<std::string> args;
+        std::string in_line;
+        while (getline(in_file, in_line))
+        {
+            args.push_back(in_line);
+        }
+        return args;
+    }
+
+    std::string ReadExpected(const fs::path& file) const
+    {
+        std::ifstream out_file(fs::path(folder_) / (file.stem().string() + out_ext_));
+        std::string out_line;
+        getline(out_file, out_line);
+        return out_line;
+    }
+
 
     std::string in_ext_ = ".in";
     std::string out_ext_ = ".out";
     std::string folder_;
-    std::function<F> function_;
+    F function_;
     std::string function_name_;
     
     std::ostream& out_info_;
-};
\ No newline at end of file
+};
+
+template <typename... Parsers, typename F>
+Tester<F, Parsers...> MakeTester(const std::string& folder, const std::string& function_name,
+                                 F function, std::ostream& out_info = std::cout)
+{
+    return Tester<F, Parsers...>(folder, function_name, std::move(function), out_info);
+}
+
+// Testers of one suite, run one after another or, given a pool, side by
+// side with the cases of every tester spread over the pool as well.
+// Reports come out in the order the testers were added either way. Given
+// isolation limits every case runs in a child process under them, one at
+// a time whatever the pool.
+class TestSuite
+{
+public:
+    explicit TestSuite(ThreadPool* pool = nullptr, const IsolationLimits* isolation = nullptr, std::ostream& out = std::cout)
+        : pool_(pool), out_(out)
+    {
+        if (isolation != nullptr)
+        {
+            isolation_ = *isolation;
+        }
+    }
+
+    template <typename T>
+    void Add(T tester)
+    {
+        runs_.push_back([tester = std::move(tester)](std::ostream& out, ThreadPool* pool, const IsolationLimits* isolation) mutable
+            {
+                if (isolation != nullptr)
+                {
+                    tester.RunIsolated(out, *isolation);
+                }
+                else
+                {
+                    tester.Run(out, pool);
+                }
+            });
+    }
+
+    void Run()
+    {
+        if (isolation_)
+        {
+            for (auto& run : runs_)
+            {
+                run(out_, nullptr, &*isolation_);
+            }
+            return;
+        }
+        if (pool_ == nullptr)
+        {
+            for (auto& run : runs_)
+            {
+                run(out_, nullptr, nullptr);
+            }
+            return;
+        }
+
+        // The tasks refer to this suite and its runs, so every submitted one
+        // has to finish before an error may leave Run
+        std::exception_ptr error;
+        std::vector<std::future<std::string>> reports;
+        try
+        {
+            reports.reserve(runs_.size());
+            for (auto& run : runs_)
+            {
+                reports.push_back(pool_->Submit([this, &run]
+                    {
+                        std::stringstream report;
+                        run(report, pool_, nullptr);
+                        return report.str();
+                    }));
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        // Each report as soon as it and the ones before it are done
+        for (auto& report : reports)
+        {
+            pool_->Wait(report);
+            try
+            {
+                std::string text = report.get();
+                if (!error)
+                {
+                    out_ << text;
+                    out_.flush();
+                }
+            }
+            catch (...)
+            {
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    ThreadPool* pool_;
+    std::optional<IsolationLimits> isolation_;
+    std::ostream& out_;
+    std::vector<std::function<void(std::ostream&, ThreadPool*, const IsolationLimits*)>> runs_;
+};
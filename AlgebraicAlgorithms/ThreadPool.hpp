@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker has its own task deque. A worker takes
+// tasks from the back of its own deque and, once that is empty, steals
+// from the front of the others. Tasks submitted from outside the pool are
+// dealt round-robin, tasks submitted by a worker go to its own deque.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t thread_count = DefaultThreadCount())
+    {
+        thread_count = std::max<size_t>(thread_count, 1);
+        queues_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i)
+        {
+            queues_.push_back(std::make_unique<Queue>());
+        }
+        threads_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i)
+        {
+            threads_.emplace_back([this, i] { Work(i); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs the tasks still queued, then joins the workers.
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& thread : threads_)
+        {
+            thread.join();
+        }
+    }
+
+    template <typename F>
+    auto Submit(F&& task) -> std::future<decltype(task())>
+    {
+        using R = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> res = packaged->get_future();
+
+        const size_t index = current_pool_ == this ? current_index_ : next_queue_++ % queues_.size();
+        {
+            std::lock_guard lock(mutex_);
+            ++pending_;
+        }
+        {
+            std::lock_guard lock(queues_[index]->mutex);
+            queues_[index]->tasks.emplace_back([packaged] { (*packaged)(); });
+        }
+        cv_.notify_one();
+        return res;
+    }
+
+    // Calls body(i) for every i in [begin, end) and returns once all calls
+    // are done. Indices are handed out one at a time, the calling thread
+    // takes part too. May be nested: a worker waiting here keeps running
+    // queued tasks. If a call throws, no further indices are handed out and
+    // the first exception is rethrown once every helper has stopped.
+    template <typename F>
+    void ParallelFor(size_t begin, size_t end, F&& body)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+
+        std::atomic<size_t> next = begin;
+        auto worker = [&]
+        {
+            for (size_t i = next++; i < end; i = next++)
+            {
+                try
+                {
+                    body(i);
+                }
+                catch (...)
+                {
+                    next = end;
+                    throw;
+                }
+            }
+        };
+
+        const size_t helpers = std::min(threads_.size(), end - begin - 1);
+        std::vector<std::future<void>> pending;
+        pending.reserve(helpers);
+        for (size_t t = 0; t < helpers; ++t)
+        {
+            pending.push_back(Submit(worker));
+        }
+
+        // The helpers refer to next, worker and body on this stack frame, so
+        // they all have to finish before anything leaves it
+        std::exception_ptr error;
+        try
+        {
+            worker();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        for (auto& f : pending)
+        {
+            Wait(f);
+            try
+            {
+                f.get();
+            }
+            catch (...)
+            {
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Blocks until f is ready. Called from a worker of this pool it runs
+    // other queued tasks meanwhile instead of sleeping.
+    template <typename R>
+    void Wait(std::future<R>& f)
+    {
+        if (current_pool_ != this)
+        {
+            f.wait();
+            return;
+        }
+        while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            std::function<void()> task;
+            if (TryPop(current_index_, task))
+            {
+                task();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    size_t GetThreadCount() const
+    {
+        return threads_.size();
+    }
+
+    static size_t DefaultThreadCount()
+    {
+        return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // Own deque first (newest task), then the oldest task of another worker.
+    bool TryPop(size_t index, std::function<void()>& task)
+    {
+        for (size_t k = 0; k < queues_.size(); ++k)
+        {
+            Queue& queue = *queues_[(index + k) % queues_.size()];
+            std::lock_guard lock(queue.mutex);
+            if (!queue.tasks.empty())
+            {
+                if (k == 0)
+                {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                }
+                else
+                {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                --pending_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Work(size_t index)
+    {
+        current_pool_ = this;
+        current_index_ = index;
+        while (true)
+        {
+            std::function<void()> task;
+            if (TryPop(index, task))
+            {
+                task();
+                continue;
+            }
+
+            std::unique_lock lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || pending_ > 0; });
+            if (stop_ && pending_ == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    static inline thread_local ThreadPool* current_pool_ = nullptr;
+    static inline thread_local size_t current_index_ = 0;
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_queue_ = 0;
+    std::atomic<size_t> pending_ = 0;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
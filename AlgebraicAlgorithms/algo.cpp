@@ -4,8 +4,35 @@
 #include <cassert>
 #include <chrono>
 #include <numeric>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <bit>
+#include <limits>
+#include <span>
+#include <exception>
 
 #include "algo.hpp"
+#include "bit_sieve.hpp"
+#include "LogDuration.hpp"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ALGO_X64
+#include <immintrin.h>
+#endif
+
+// Per-function instruction sets for the kernels picked at run time; MSVC
+// needs no attribute to use an intrinsic.
+#if defined(__GNUC__)
+#define TARGET(features) __attribute__((target(features)))
+#else
+#define TARGET(features)
+#endif
 
 
 
@@ -81,14 +108,14 @@ apa::lint FibIter(apa::lint n)
     }
     if (n < 2)
         return n;
-    apa::lint prev2 = 0;
+    // (prev, cur) = (F(k), F(k + 1)), advanced in place so the loop only
+    // reallocates when the numbers outgrow their capacity
     apa::lint prev = 1;
     apa::lint cur = 1;
     while (--n)
     {
-        prev2 = prev;
-        prev = cur;
-        cur = prev + prev2;
+        apa::add_to(prev, prev, cur);
+        std::swap(prev, cur);
     }
     return prev;
 }
@@ -105,8 +132,53 @@ size_t FibMatrix(size_t n)
 {
     if (n < 2)
         return n;
-    Matrix<size_t> m({ {0,1}, {1,1} });
-    return m.Pow(n + 1)[0][0];
+    Matrix<size_t, 2> m({ {0,1}, {1,1} });
+    m.PowInPlace(n + 1);
+    return m[0][0];
+}
+
+// Walks the bits of n from the top keeping (F(k), F(k - 1)) and doubles k with
+// two squarings per bit:
+//   F(2k + 1) = 4 F(k)^2 - F(k - 1)^2 + 2 (-1)^k
+//   F(2k - 1) = F(k)^2 + F(k - 1)^2
+//   F(2k) = F(2k + 1) - F(2k - 1)
+apa::lint FibFastDoubling(size_t n)
+{
+    if (n < 2)
+        return apa::lint(static_cast<long long>(n));
+    int bit = 8 * sizeof(size_t) - 1;
+    while (!((n >> bit) & 1))
+    {
+        --bit;
+    }
+    apa::lint cur = 1;
+    apa::lint prev = 0;
+    bool k_odd = true;
+    for (--bit; bit >= 0; --bit)
+    {
+        apa::lint cur_sq = apa::sqr(cur);
+        apa::lint prev_sq = apa::sqr(prev);
+
+        apa::lint odd = cur_sq * 4;
+        odd -= prev_sq;
+        odd += k_odd ? -2 : 2;
+        apa::add_to(prev_sq, cur_sq, prev_sq);
+        apa::sub_to(cur_sq, odd, prev_sq);
+
+        // odd = F(2k + 1), cur_sq = F(2k), prev_sq = F(2k - 1)
+        k_odd = (n >> bit) & 1;
+        if (k_odd)
+        {
+            cur = std::move(odd);
+            prev = std::move(cur_sq);
+        }
+        else
+        {
+            cur = std::move(cur_sq);
+            prev = std::move(prev_sq);
+        }
+    }
+    return cur;
 }
 
 bool IsPrimeNaive(size_t n)
@@ -161,60 +233,1497 @@ size_t FindPrimeCountDivPrime(size_t n)
 
 int FindPrimeCountSieve(int n)
 {
-    
-    std::vector<int> v(n + 1, true);
+    if (n < 2)
+    {
+        return 0;
+    }
+    // One byte per number holding 0 or 1, so the survivors are the set bits
+    std::vector<uint8_t> v(n + 1, 1);
     for (size_t i = 2; i * i <= n; ++i)
     {
         if (v[i])
         {
             for (size_t j = i * i; j <= n; j += i)
             {
-                v[j] = false;
+                v[j] = 0;
             }
         }
     }
-    return std::accumulate(v.begin() + 2, v.end(), 0);
+    return static_cast<int>(CountBits(v.data() + 2, v.size() - 2));
 }
 
 int FindPrimeCountSieveLinear(int n)
 {
-    if (n > 1e8)
+    PROFILE_ZONE(__FUNCTION__);
+    if (n > 1e9)
     {
         std::cout << "Cowardly refusing to run memory intensive Linear Sieve on input " + std::to_string(n) << std::endl;
         return -1;
     }
-    //LOG_DURATION(std::format("{} FOR N = ", __FUNCTION__) + std::to_string(n) + "\n");
-    std::vector<int> lp(n + 1, 0);
-    std::vector<int> pr;
-    for (int i = 2; i <= n; ++i)
+    if (n < 2)
     {
-        if (lp[i] == 0)
-        {
-            lp[i] = i;
-            pr.push_back(lp[i]);
-        }
-        for (int j = 0; i * pr[j] <= n; ++j)
-        {
-            lp[i * pr[j]] = pr[j];
-            if (pr[j] == lp[i])
-                break;
-        }
+        return 0;
     }
-    return pr.size();
+    return static_cast<int>(SmallestFactorTable(n).CountPrimes());
 }
 
 int FindPrimeCountSieveCompact(int n)
 {
-    std::vector<bool> v(n + 1, true);
+    if (n < 2)
+    {
+        return 0;
+    }
+    BitSieve v(n + 1);
     for (size_t i = 2; i * i <= n; ++i)
     {
         if (v[i])
         {
             for (size_t j = i * i; j <= n; j += i)
             {
-                v[j] = false;
+                v.Reset(j);
+            }
+        }
+    }
+    return static_cast<int>(v.Count(2, n + 1));
+}
+
+namespace
+{
+    // Odd numbers covered by one window of the segmented sieve, one byte each,
+    // so a window fits into a 32 KiB L1 data cache.
+    constexpr size_t SIEVE_SEGMENT_SIZE = 32 * 1024;
+}
+
+uint64_t IntSqrt(uint64_t n)
+{
+    // The double root rounds up to 2^32 near the top of the range, and
+    // the squares below must not wrap around
+    uint64_t r = std::min<uint64_t>(static_cast<uint64_t>(std::sqrt(static_cast<double>(n))), 0xFFFFFFFF);
+    while (r * r > n)
+    {
+        --r;
+    }
+    while (r < 0xFFFFFFFF && (r + 1) * (r + 1) <= n)
+    {
+        ++r;
+    }
+    return r;
+}
+
+uint64_t IntCbrt(uint64_t n)
+{
+    // 2642245 is the cube root of 2^64 - 1 rounded down, so no cube
+    // below wraps around
+    uint64_t r = std::min<uint64_t>(static_cast<uint64_t>(std::cbrt(static_cast<double>(n))), 2642245);
+    while (r * r * r > n)
+    {
+        --r;
+    }
+    while (r < 2642245 && (r + 1) * (r + 1) * (r + 1) <= n)
+    {
+        ++r;
+    }
+    return r;
+}
+
+std::vector<uint32_t> FindPrimesUpTo(uint32_t n)
+{
+    PROFILE_ZONE(__FUNCTION__);
+    std::vector<uint32_t> primes;
+    if (n < 2)
+    {
+        return primes;
+    }
+    primes.push_back(2);
+
+    // odd[i] stands for 2 * i + 1
+    std::vector<uint8_t> odd(n / 2 + 1, 1);
+    for (uint64_t i = 3; i <= n; i += 2)
+    {
+        if (odd[i / 2])
+        {
+            primes.push_back(static_cast<uint32_t>(i));
+            for (uint64_t j = i * i; j <= n; j += 2 * i)
+            {
+                odd[j / 2] = 0;
+            }
+        }
+    }
+    return primes;
+}
+
+namespace
+{
+    // Fills segment[0, size) with 1 for the primes and 0 for the composites
+    // among the odd numbers segment_low + 2 * i; segment_low is odd and at
+    // least 3, and primes holds every prime up to sqrt of the window's end.
+    // next[k] carries the next odd multiple of primes[k + 1] from one window
+    // to the following one; a base prime joins once its square falls inside
+    // the current window.
+    void SieveOddWindow(uint64_t segment_low, size_t size, const std::vector<uint32_t>& primes,
+        std::vector<uint64_t>& next, std::vector<uint8_t>& segment)
+    {
+        PROFILE_ZONE("SieveOddWindow");
+        const uint64_t segment_high = segment_low + 2 * (size - 1);
+        std::fill(segment.begin(), segment.begin() + size, 1);
+
+        while (next.size() + 1 < primes.size()
+            && static_cast<uint64_t>(primes[next.size() + 1]) * primes[next.size() + 1] <= segment_high)
+        {
+            const uint64_t p = primes[next.size() + 1];
+            // Offset of the first odd multiple from p * p on, rounding up
+            // segment_low itself would overflow near 2^64
+            uint64_t offset = p * p >= segment_low ? p * p - segment_low : (p - segment_low % p) % p;
+            if (offset % 2 != 0)
+            {
+                offset += p;
+            }
+            next.push_back(segment_low + offset);
+        }
+
+        for (size_t k = 0; k < next.size(); ++k)
+        {
+            const size_t p = primes[k + 1];
+            size_t j = static_cast<size_t>((next[k] - segment_low) / 2);
+            for (; j < size; j += p)
+            {
+                segment[j] = 0;
+            }
+            next[k] = segment_low + 2 * j;
+        }
+    }
+
+    // Number of primes among the odd numbers in [low, high], low odd and at
+    // least 3. primes must hold every prime up to sqrt(high).
+    uint64_t CountOddPrimes(uint64_t low, uint64_t high, const std::vector<uint32_t>& primes)
+    {
+        PROFILE_ZONE("CountOddPrimes");
+        if (low > high)
+        {
+            return 0;
+        }
+
+        std::vector<uint64_t> next;
+        next.reserve(primes.size());
+        std::vector<uint8_t> segment(static_cast<size_t>(std::min<uint64_t>(SIEVE_SEGMENT_SIZE, (high - low) / 2 + 1)));
+
+        uint64_t count = 0;
+        // segment_low < low once the last window ends at the top of uint64_t
+        for (uint64_t segment_low = low; segment_low <= high && segment_low >= low; segment_low += 2 * SIEVE_SEGMENT_SIZE)
+        {
+            const size_t size = static_cast<size_t>(std::min<uint64_t>(SIEVE_SEGMENT_SIZE, (high - segment_low) / 2 + 1));
+            SieveOddWindow(segment_low, size, primes, next, segment);
+            count += std::count(segment.begin(), segment.begin() + size, 1);
+        }
+        return count;
+    }
+}
+
+uint64_t FindPrimeCountSieveSegmented(uint64_t n)
+{
+    PROFILE_ZONE(__FUNCTION__);
+    if (n < 2)
+    {
+        return 0;
+    }
+
+    const std::vector<uint32_t> primes = FindPrimesUpTo(static_cast<uint32_t>(IntSqrt(n)));
+    return 1 + CountOddPrimes(3, n, primes);
+}
+
+uint64_t FindPrimeCountSieveParallel(uint64_t n, ThreadPool* pool)
+{
+    if (n < 2)
+    {
+        return 0;
+    }
+    if (pool == nullptr)
+    {
+        ThreadPool local_pool;
+        return FindPrimeCountSieveParallel(n, &local_pool);
+    }
+
+    PROFILE_ZONE(__FUNCTION__);
+    const std::vector<uint32_t> primes = FindPrimesUpTo(static_cast<uint32_t>(IntSqrt(n)));
+
+    // At least 16 windows per task so per-task setup stays small, and about
+    // 64 tasks per thread so stealing can even out the slower high chunks.
+    const uint64_t chunk = std::max<uint64_t>(2 * SIEVE_SEGMENT_SIZE * 16,
+        (n / (pool->GetThreadCount() * 64) + 1) & ~uint64_t(1));
+    std::vector<std::future<uint64_t>> counts;
+    // The chunks refer to primes on this stack frame, so every queued one
+    // has to finish before an error may leave it
+    std::exception_ptr error;
+    try
+    {
+        for (uint64_t low = 3; low <= n; low += chunk)
+        {
+            const uint64_t high = std::min(n, low + chunk - 2);
+            counts.push_back(pool->Submit([&primes, low, high] { return CountOddPrimes(low, high, primes); }));
+        }
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    // Called from a task of the same pool, Wait runs the chunks meanwhile
+    uint64_t count = 1;
+    for (auto& f : counts)
+    {
+        pool->Wait(f);
+        try
+        {
+            count += f.get();
+        }
+        catch (...)
+        {
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return count;
+}
+
+namespace
+{
+    // Mod-30 wheel: byte i of a wheel sieve holds the numbers 30 * i + r for
+    // the eight residues r coprime to 30, bit k standing for WHEEL_RESIDUES[k].
+    constexpr uint32_t WHEEL_RESIDUES[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+    // Gaps from one residue to the next, the last one wrapping to 31.
+    constexpr uint32_t WHEEL_GAPS[8] = { 6, 4, 2, 4, 2, 4, 6, 2 };
+    // Bytes in one window of the wheel sieve, 30 numbers per byte.
+    constexpr size_t WHEEL_SEGMENT_SIZE = 32 * 1024;
+    // Primes that are crossed off by copying WheelPattern instead of sieving,
+    // the pattern repeats every 7 * 11 * 13 * 17 bytes.
+    constexpr uint32_t PRESIEVED_PRIMES[4] = { 7, 11, 13, 17 };
+    constexpr size_t WHEEL_PATTERN_SIZE = 7 * 11 * 13 * 17;
+
+    constexpr std::array<uint8_t, 30> MakeWheelBits()
+    {
+        std::array<uint8_t, 30> bits{};
+        for (size_t k = 0; k < 8; ++k)
+        {
+            bits[WHEEL_RESIDUES[k]] = static_cast<uint8_t>(1u << k);
+        }
+        return bits;
+    }
+
+    // WHEEL_BITS[r] is the bit of residue r, 0 for residues sharing a factor with 30
+    constexpr std::array<uint8_t, 30> WHEEL_BITS = MakeWheelBits();
+
+    // Walking the multiples p * q of a prime p = 30 * a + WHEEL_RESIDUES[c]
+    // over the wheel positions w of q: the bit p * q lands on is
+    // WHEEL_CLEAR[c][w] (inverted), and the next multiple is
+    // a * WHEEL_GAPS[w] + WHEEL_STEP[c][w] bytes further on.
+    struct WheelSteps
+    {
+        uint8_t clear[8][8];
+        uint8_t step[8][8];
+    };
+
+    constexpr WheelSteps MakeWheelSteps()
+    {
+        WheelSteps res{};
+        for (size_t c = 0; c < 8; ++c)
+        {
+            for (size_t w = 0; w < 8; ++w)
+            {
+                const uint32_t product = WHEEL_RESIDUES[c] * WHEEL_RESIDUES[w] % 30;
+                res.clear[c][w] = static_cast<uint8_t>(~WHEEL_BITS[product]);
+                res.step[c][w] = static_cast<uint8_t>((WHEEL_RESIDUES[c] * WHEEL_GAPS[w] + product) / 30);
+            }
+        }
+        return res;
+    }
+
+    constexpr WheelSteps WHEEL_STEPS = MakeWheelSteps();
+
+    size_t WheelIndex(uint64_t n)
+    {
+        const uint32_t r = static_cast<uint32_t>(n % 30);
+        return std::find(std::begin(WHEEL_RESIDUES), std::end(WHEEL_RESIDUES), r) - std::begin(WHEEL_RESIDUES);
+    }
+
+    // One period of wheel bytes with the multiples of 7, 11, 13 and 17 cleared.
+    const std::vector<uint8_t>& WheelPattern()
+    {
+        static const std::vector<uint8_t> pattern = []
+        {
+            std::vector<uint8_t> res(WHEEL_PATTERN_SIZE, 0xFF);
+            for (size_t i = 0; i < WHEEL_PATTERN_SIZE; ++i)
+            {
+                for (size_t k = 0; k < 8; ++k)
+                {
+                    const uint64_t value = 30 * i + WHEEL_RESIDUES[k];
+                    for (uint32_t p : PRESIEVED_PRIMES)
+                    {
+                        if (value % p == 0)
+                        {
+                            res[i] &= static_cast<uint8_t>(~(1u << k));
+                        }
+                    }
+                }
+            }
+            return res;
+        }();
+        return pattern;
+    }
+}
+
+uint64_t FindPrimeCountSieveWheel(uint64_t n)
+{
+    PROFILE_ZONE(__FUNCTION__);
+    uint64_t count = 0;
+    for (uint32_t p : { 2, 3, 5, 7, 11, 13, 17 })
+    {
+        count += p <= n;
+    }
+    if (n < 19)
+    {
+        return count;
+    }
+
+    const std::vector<uint32_t> primes = FindPrimesUpTo(static_cast<uint32_t>(IntSqrt(n)));
+    const std::vector<uint8_t>& pattern = WheelPattern();
+
+    // Crossing-off state of a base prime p: the byte of the next multiple
+    // p * q to clear, the wheel position of q and that of p itself. Only q
+    // coprime to 30 are visited.
+    struct Multiple
+    {
+        uint64_t byte;
+        uint32_t wheel;
+        uint32_t residue;
+    };
+    std::vector<Multiple> next;
+    size_t first_sieved = 0;
+    while (first_sieved < primes.size() && primes[first_sieved] < 19)
+    {
+        ++first_sieved;
+    }
+
+    const uint64_t bytes = n / 30 + 1;
+    std::vector<uint8_t> segment(static_cast<size_t>(std::min<uint64_t>(WHEEL_SEGMENT_SIZE, bytes)));
+    for (uint64_t low = 0; low < bytes; low += WHEEL_SEGMENT_SIZE)
+    {
+        const size_t size = static_cast<size_t>(std::min<uint64_t>(WHEEL_SEGMENT_SIZE, bytes - low));
+        const uint64_t segment_end = 30 * (low + size);
+
+        size_t offset = static_cast<size_t>(low % WHEEL_PATTERN_SIZE);
+        for (size_t i = 0; i < size;)
+        {
+            const size_t chunk = std::min(size - i, WHEEL_PATTERN_SIZE - offset);
+            std::memcpy(segment.data() + i, pattern.data() + offset, chunk);
+            i += chunk;
+            offset = 0;
+        }
+        if (low == 0)
+        {
+            // 1 is not a prime
+            segment[0] &= 0xFE;
+        }
+
+        while (first_sieved + next.size() < primes.size()
+            && static_cast<uint64_t>(primes[first_sieved + next.size()]) * primes[first_sieved + next.size()] < segment_end)
+        {
+            const uint64_t p = primes[first_sieved + next.size()];
+            const uint32_t residue = static_cast<uint32_t>(WheelIndex(p));
+            next.push_back({ p * p / 30, residue, residue });
+        }
+
+        for (size_t k = 0; k < next.size(); ++k)
+        {
+            const uint32_t p = primes[first_sieved + k];
+            const uint64_t a = p / 30;
+            const uint8_t* clear = WHEEL_STEPS.clear[next[k].residue];
+            const uint8_t* step = WHEEL_STEPS.step[next[k].residue];
+            uint64_t byte = next[k].byte;
+            uint32_t wheel = next[k].wheel;
+            while (byte < low + size)
+            {
+                segment[static_cast<size_t>(byte - low)] &= clear[wheel];
+                byte += a * WHEEL_GAPS[wheel] + step[wheel];
+                wheel = (wheel + 1) % 8;
+            }
+            next[k].byte = byte;
+            next[k].wheel = wheel;
+        }
+
+        if (low + size == bytes)
+        {
+            // drop the numbers above n from the last byte
+            uint8_t keep = 0;
+            for (size_t k = 0; k < 8; ++k)
+            {
+                if (30 * (bytes - 1) + WHEEL_RESIDUES[k] <= n)
+                {
+                    keep |= static_cast<uint8_t>(1u << k);
+                }
             }
+            segment[size - 1] &= keep;
+        }
+
+        count += CountBits(segment.data(), size);
+    }
+    return count;
+}
+
+uint64_t FindPrimeCountLucy(uint64_t n)
+{
+    PROFILE_ZONE(__FUNCTION__);
+    if (n < 2)
+    {
+        return 0;
+    }
+
+    // small[v] = S(v) for v <= root and large[i] = S(n / i) for i <= root,
+    // where S(v) starts as the count of 2..v and, after the step for p,
+    // counts the numbers up to v that are prime or have no factor <= p.
+    const uint64_t root = IntSqrt(n);
+    std::vector<uint64_t> small(root + 1), large(root + 1);
+    for (uint64_t v = 1; v <= root; ++v)
+    {
+        small[v] = v - 1;
+        large[v] = n / v - 1;
+    }
+
+    for (uint64_t p = 2; p <= root; ++p)
+    {
+        if (small[p] == small[p - 1])
+        {
+            continue;
+        }
+        const uint64_t primes_below = small[p - 1];
+        const uint64_t square = p * p;
+
+        const uint64_t large_end = std::min(root, n / square);
+        for (uint64_t i = 1; i <= large_end; ++i)
+        {
+            const uint64_t d = i * p;
+            large[i] -= (d <= root ? large[d] : small[n / d]) - primes_below;
+        }
+        for (uint64_t v = root; v >= square; --v)
+        {
+            small[v] -= small[v / p] - primes_below;
         }
     }
-    return std::accumulate(v.begin() + 2, v.end(), 0);
-}
\ No newline at end of file
+    return large[1];
+}
+
+namespace
+{
+    // Prefix sums over the flags of one sieve segment, updated as numbers
+    // are crossed off.
+    class FenwickTree
+    {
+    public:
+        void Build(const std::vector<uint8_t>& flags, size_t size)
+        {
+            tree_.assign(size + 1, 0);
+            for (size_t i = 1; i <= size; ++i)
+            {
+                tree_[i] += flags[i - 1];
+                const size_t parent = i + (i & (0 - i));
+                if (parent <= size)
+                {
+                    tree_[parent] += tree_[i];
+                }
+            }
+        }
+
+        void Remove(size_t index)
+        {
+            for (size_t i = index + 1; i < tree_.size(); i += i & (0 - i))
+            {
+                --tree_[i];
+            }
+        }
+
+        // Sum of flags [0, index]
+        uint64_t Prefix(size_t index) const
+        {
+            uint64_t sum = 0;
+            for (size_t i = index + 1; i > 0; i -= i & (0 - i))
+            {
+                sum += tree_[i];
+            }
+            return sum;
+        }
+
+    private:
+        std::vector<uint32_t> tree_;
+    };
+
+    // phi(v, c) = numbers in [1, v] with no prime factor among the first c
+    // primes, read off one period of the product of those primes.
+    class SmallPhi
+    {
+    public:
+        SmallPhi(const std::vector<uint32_t>& primes, size_t c)
+        {
+            for (size_t k = 0; k < c; ++k)
+            {
+                period_ *= primes[k];
+            }
+            table_.assign(period_ + 1, 1);
+            table_[0] = 0;
+            for (size_t k = 0; k < c; ++k)
+            {
+                for (uint64_t j = primes[k]; j <= period_; j += primes[k])
+                {
+                    table_[j] = 0;
+                }
+            }
+            for (uint64_t j = 1; j <= period_; ++j)
+            {
+                table_[j] += table_[j - 1];
+            }
+        }
+
+        uint64_t operator()(uint64_t v) const
+        {
+            return v / period_ * table_[period_] + table_[v % period_];
+        }
+
+    private:
+        uint64_t period_ = 1;
+        std::vector<uint32_t> table_;
+    };
+
+    // P2(x, a): numbers up to x with exactly two prime factors, both larger
+    // than y, as the sum of pi(x / p) - pi(p) + 1 over primes y < p <= sqrt(x).
+    // The pi(x / p) are collected by one segmented sieve over [0, x / y].
+    uint64_t CountSemiprimesP2(uint64_t x, uint64_t y, const std::vector<uint32_t>& primes)
+    {
+        const size_t begin = std::upper_bound(primes.begin(), primes.end(), y) - primes.begin();
+        const size_t end = std::upper_bound(primes.begin(), primes.end(), IntSqrt(x)) - primes.begin();
+        if (begin >= end)
+        {
+            return 0;
+        }
+
+        // pi(primes[k]) - 1 == k
+        uint64_t res = 0;
+        for (size_t k = begin; k < end; ++k)
+        {
+            res -= k;
+        }
+
+        const uint64_t limit = x / primes[begin];
+        const size_t segment_size = std::max<size_t>(size_t(1) << 16, static_cast<size_t>(IntSqrt(limit)));
+        std::vector<uint8_t> segment(segment_size);
+        uint64_t count = 0;
+        size_t query = end;
+        for (uint64_t low = 0; query > begin; low += segment_size)
+        {
+            const uint64_t high = std::min<uint64_t>(low + segment_size, limit + 1);
+            const size_t size = static_cast<size_t>(high - low);
+            std::fill(segment.begin(), segment.begin() + size, 1);
+            for (uint64_t v = low; v < std::min<uint64_t>(2, high); ++v)
+            {
+                segment[v - low] = 0;
+            }
+            for (uint64_t p : primes)
+            {
+                if (p * p >= high)
+                {
+                    break;
+                }
+                for (uint64_t j = std::max(p * p, (low + p - 1) / p * p); j < high; j += p)
+                {
+                    segment[j - low] = 0;
+                }
+            }
+
+            size_t cursor = 0;
+            while (query > begin && x / primes[query - 1] < high)
+            {
+                const size_t v = static_cast<size_t>(x / primes[query - 1] - low);
+                count += std::count(segment.begin() + cursor, segment.begin() + v + 1, 1);
+                cursor = v + 1;
+                res += count;
+                --query;
+            }
+            count += std::count(segment.begin() + cursor, segment.begin() + size, 1);
+        }
+        return res;
+    }
+}
+
+uint64_t FindPrimeCountMeisselLehmer(uint64_t x)
+{
+    PROFILE_ZONE(__FUNCTION__);
+    if (x < 1000)
+    {
+        return FindPrimeCountSieveSegmented(x);
+    }
+
+    // y = alpha * cbrt(x); a larger alpha moves work from the sieve over
+    // [1, x / y] to the leaf tables up to y.
+    const double alpha = std::max(1.0, std::log(static_cast<double>(x)) / 10);
+    const uint64_t y = std::min<uint64_t>(static_cast<uint64_t>(IntCbrt(x) * alpha), IntSqrt(x));
+    const std::vector<uint32_t> primes = FindPrimesUpTo(static_cast<uint32_t>(IntSqrt(x)));
+    const size_t a = std::upper_bound(primes.begin(), primes.end(), y) - primes.begin();
+    const size_t c = std::min<size_t>(a, 6);
+    const SmallPhi phi_c(primes, c);
+
+    // least prime factor and Moebius function up to y, lpf[1] beyond any prime
+    std::vector<uint32_t> lpf(y + 1, 0);
+    std::vector<int8_t> mu(y + 1, 1);
+    lpf[1] = std::numeric_limits<uint32_t>::max();
+    for (size_t k = 0; k < a; ++k)
+    {
+        const uint64_t p = primes[k];
+        for (uint64_t j = p; j <= y; j += p)
+        {
+            if (lpf[j] == 0)
+            {
+                lpf[j] = static_cast<uint32_t>(p);
+            }
+            mu[j] = static_cast<int8_t>(-mu[j]);
+        }
+        for (uint64_t j = p * p; j <= y; j += p * p)
+        {
+            mu[j] = 0;
+        }
+    }
+
+    // Ordinary leaves: squarefree n <= y with no prime factor among the
+    // first c primes, each adding mu(n) * phi(x / n, c).
+    int64_t phi = 0;
+    for (uint64_t n = 1; n <= y; ++n)
+    {
+        if (mu[n] != 0 && (c == 0 || lpf[n] > primes[c - 1]))
+        {
+            phi += mu[n] * static_cast<int64_t>(phi_c(x / n));
+        }
+    }
+
+    // Special leaves: n = p_b * m with m <= y < n, squarefree m and
+    // lpf(m) > p_b, each subtracting mu(m) * phi(x / n, b - 1). The values
+    // phi(v, b - 1) for v < x / y come from a segmented sieve over [1, x / y]
+    // that has crossed off the first b - 1 primes when prime b is handled:
+    // the counts before the segment are carried in phi_before[b], the rest
+    // is a prefix sum of the segment.
+    const uint64_t limit = x / y;
+    const size_t segment_size = std::bit_ceil(static_cast<size_t>(IntSqrt(limit)));
+    std::vector<uint8_t> segment(segment_size);
+    std::vector<uint64_t> phi_before(a + 1, 0);
+    FenwickTree tree;
+    for (uint64_t low = 1; low <= limit; low += segment_size)
+    {
+        const uint64_t high = std::min<uint64_t>(low + segment_size, limit + 1);
+        const size_t size = static_cast<size_t>(high - low);
+        std::fill(segment.begin(), segment.begin() + size, 1);
+        for (size_t b = 0; b < c; ++b)
+        {
+            const uint64_t p = primes[b];
+            for (uint64_t j = (low + p - 1) / p * p; j < high; j += p)
+            {
+                segment[j - low] = 0;
+            }
+        }
+        tree.Build(segment, size);
+
+        // primes[b] is p_(b + 1), the sieve has crossed off the first b primes
+        for (size_t b = c; b + 1 < a; ++b)
+        {
+            const uint64_t p = primes[b];
+            const uint64_t max_m = std::min(x / (p * low), y);
+            const uint64_t min_m = std::max(x / (p * high), y / p);
+            if (p >= max_m)
+            {
+                break;
+            }
+
+            for (uint64_t m = max_m; m > min_m; --m)
+            {
+                if (mu[m] != 0 && lpf[m] > p)
+                {
+                    const uint64_t v = x / (p * m);
+                    phi -= mu[m] * static_cast<int64_t>(phi_before[b] + tree.Prefix(static_cast<size_t>(v - low)));
+                }
+            }
+
+            phi_before[b] += tree.Prefix(size - 1);
+            for (uint64_t j = (low + p - 1) / p * p; j < high; j += p)
+            {
+                if (segment[j - low])
+                {
+                    segment[j - low] = 0;
+                    tree.Remove(static_cast<size_t>(j - low));
+                }
+            }
+        }
+    }
+
+    return static_cast<uint64_t>(phi) + a - 1 - CountSemiprimesP2(x, y, primes);
+}
+
+namespace
+{
+    // Low 64 bits of a * b, the high 64 bits go to high.
+    inline uint64_t MulWide(uint64_t a, uint64_t b, uint64_t& high)
+    {
+#if defined(__SIZEOF_INT128__)
+        const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        high = static_cast<uint64_t>(product >> 64);
+        return static_cast<uint64_t>(product);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        return _umul128(a, b, &high);
+#else
+        const uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+        const uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+        const uint64_t lo_lo = a_lo * b_lo;
+        const uint64_t hi_lo = a_hi * b_lo;
+        const uint64_t lo_hi = a_lo * b_hi;
+        const uint64_t middle = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+        high = a_hi * b_hi + (hi_lo >> 32) + (middle >> 32);
+        return (middle << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+    }
+
+    // Arithmetic modulo an odd n < 2^64 on values kept as x * 2^64 mod n.
+    class Montgomery64
+    {
+    public:
+        explicit Montgomery64(uint64_t n)
+            : n_(n)
+        {
+            // n * inv == 1 (mod 2^64), each Newton step doubles the correct bits
+            inv_ = n;
+            for (int i = 0; i < 5; ++i)
+            {
+                inv_ *= 2 - n * inv_;
+            }
+            one_ = (0 - n) % n;
+            r2_ = one_;
+            for (int i = 0; i < 64; ++i)
+            {
+                r2_ = Add(r2_, r2_);
+            }
+        }
+
+        uint64_t To(uint64_t x) const
+        {
+            return Mul(x % n_, r2_);
+        }
+
+        uint64_t One() const
+        {
+            return one_;
+        }
+
+        uint64_t MinusOne() const
+        {
+            return n_ - one_;
+        }
+
+        uint64_t Add(uint64_t a, uint64_t b) const
+        {
+            const uint64_t sum = a + b;
+            return (sum < a || sum >= n_) ? sum - n_ : sum;
+        }
+
+        uint64_t Mul(uint64_t a, uint64_t b) const
+        {
+            uint64_t high;
+            const uint64_t low = MulWide(a, b, high);
+            uint64_t mn_high;
+            MulWide(low * inv_, n_, mn_high);
+            return high >= mn_high ? high - mn_high : high - mn_high + n_;
+        }
+
+    private:
+        uint64_t n_;
+        uint64_t inv_;
+        uint64_t one_;
+        uint64_t r2_;
+    };
+
+    // Witness sets that make Miller-Rabin exact below 2^32 and below 2^64.
+    constexpr uint64_t WITNESSES_32[] = { 2, 7, 61 };
+    constexpr uint64_t WITNESSES_64[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+
+    constexpr uint32_t TRIAL_PRIMES[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53 };
+
+    // 0 or 1 when trial division by TRIAL_PRIMES already decides n,
+    // -1 when n still needs Miller-Rabin.
+    int TrialDivide(uint64_t n)
+    {
+        if (n < 2)
+        {
+            return 0;
+        }
+        for (uint32_t p : TRIAL_PRIMES)
+        {
+            if (n % p == 0)
+            {
+                return n == p;
+            }
+        }
+        return n < 59 * 59 ? 1 : -1;
+    }
+
+    // n odd with n - 1 = d * 2^s; true if witness a does not prove n composite
+    bool PassesMillerRabin(const Montgomery64& mont, uint64_t n, uint64_t d, int s, uint64_t a)
+    {
+        a %= n;
+        if (a == 0)
+        {
+            return true;
+        }
+
+        const uint64_t base = mont.To(a);
+        uint64_t x = mont.One();
+        for (int bit = std::bit_width(d) - 1; bit >= 0; --bit)
+        {
+            x = mont.Mul(x, x);
+            if ((d >> bit) & 1)
+            {
+                x = mont.Mul(x, base);
+            }
+        }
+
+        if (x == mont.One() || x == mont.MinusOne())
+        {
+            return true;
+        }
+        for (int r = 1; r < s; ++r)
+        {
+            x = mont.Mul(x, x);
+            if (x == mont.MinusOne())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool IsPrimeMillerRabin(uint64_t n)
+{
+    const int trial = TrialDivide(n);
+    if (trial >= 0)
+    {
+        return trial;
+    }
+
+    const Montgomery64 mont(n);
+    const int s = std::countr_zero(n - 1);
+    const uint64_t d = (n - 1) >> s;
+    if (n < (uint64_t(1) << 32))
+    {
+        return std::all_of(std::begin(WITNESSES_32), std::end(WITNESSES_32),
+            [&](uint64_t a) { return PassesMillerRabin(mont, n, d, s, a); });
+    }
+    return std::all_of(std::begin(WITNESSES_64), std::end(WITNESSES_64),
+        [&](uint64_t a) { return PassesMillerRabin(mont, n, d, s, a); });
+}
+
+std::vector<uint8_t> IsPrimeMany(const std::vector<uint64_t>& values)
+{
+    // Candidates surviving trial division go through the witnesses one at a
+    // time. For each witness they are taken LANES at a time with the
+    // modular exponentiations of different numbers interleaved, so the
+    // multiplier works on independent chains instead of waiting on one.
+    // A candidate leaves as soon as a witness proves it composite.
+    constexpr size_t LANES = 4;
+
+    struct Candidate
+    {
+        Montgomery64 mont;
+        uint64_t n;
+        uint64_t d;
+        int s;
+        size_t index;
+    };
+
+    std::vector<uint8_t> res(values.size(), 0);
+    std::vector<Candidate> alive;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        const int trial = TrialDivide(values[i]);
+        if (trial >= 0)
+        {
+            res[i] = static_cast<uint8_t>(trial);
+        }
+        else
+        {
+            const uint64_t n = values[i];
+            const int s = std::countr_zero(n - 1);
+            alive.push_back({ Montgomery64(n), n, (n - 1) >> s, s, i });
+        }
+    }
+
+    for (uint64_t witness : WITNESSES_64)
+    {
+        size_t survivors = 0;
+        for (size_t group = 0; group < alive.size(); group += LANES)
+        {
+            // the last group is padded with copies of its first candidate
+            const Candidate* lane[LANES];
+            int top_bit = 0;
+            for (size_t k = 0; k < LANES; ++k)
+            {
+                lane[k] = &alive[group + k < alive.size() ? group + k : group];
+                top_bit = std::max(top_bit, static_cast<int>(std::bit_width(lane[k]->d)) - 1);
+            }
+
+            uint64_t x[LANES], base[LANES];
+            for (size_t k = 0; k < LANES; ++k)
+            {
+                base[k] = lane[k]->mont.To(witness);
+                x[k] = lane[k]->mont.One();
+            }
+            for (int bit = top_bit; bit >= 0; --bit)
+            {
+                // multiply unconditionally and select, the exponent bits are
+                // too random for the branch predictor
+                for (size_t k = 0; k < LANES; ++k)
+                {
+                    const uint64_t square = lane[k]->mont.Mul(x[k], x[k]);
+                    const uint64_t product = lane[k]->mont.Mul(square, base[k]);
+                    x[k] = ((lane[k]->d >> bit) & 1) ? product : square;
+                }
+            }
+
+            for (size_t k = 0; k < LANES && group + k < alive.size(); ++k)
+            {
+                const Montgomery64& mont = lane[k]->mont;
+                bool passed = witness % lane[k]->n == 0 || x[k] == mont.One() || x[k] == mont.MinusOne();
+                for (int r = 1; r < lane[k]->s && !passed; ++r)
+                {
+                    x[k] = mont.Mul(x[k], x[k]);
+                    passed = x[k] == mont.MinusOne();
+                }
+                if (passed)
+                {
+                    alive[survivors++] = alive[group + k];
+                }
+            }
+        }
+        alive.erase(alive.begin() + survivors, alive.end());
+    }
+
+    for (const Candidate& candidate : alive)
+    {
+        res[candidate.index] = 1;
+    }
+    return res;
+}
+
+PrimeRange::PrimeRange(uint64_t lo, uint64_t hi)
+    : hi_(hi)
+    , current_(lo)
+{
+    // 2 is handed out by hand, the windows only hold odd numbers from 3 on
+    segment_low_ = std::max<uint64_t>(lo, 3) | 1;
+    if (lo <= hi)
+    {
+        primes_ = FindPrimesUpTo(static_cast<uint32_t>(IntSqrt(hi)));
+        next_.reserve(primes_.size());
+    }
+}
+
+PrimeRange::iterator PrimeRange::begin()
+{
+    if (!started_)
+    {
+        started_ = true;
+        if (current_ <= 2 && hi_ >= 2)
+        {
+            current_ = 2;
+        }
+        else
+        {
+            Advance();
+        }
+    }
+    return iterator(this);
+}
+
+void PrimeRange::Advance()
+{
+    while (true)
+    {
+        while (position_ < size_)
+        {
+            if (segment_[position_++])
+            {
+                current_ = segment_low_ + 2 * (position_ - 1);
+                return;
+            }
+        }
+        if (size_ != 0)
+        {
+            segment_low_ += 2 * size_;
+        }
+        if (segment_low_ > hi_ || segment_low_ < 3)
+        {
+            done_ = true;
+            return;
+        }
+
+        size_ = static_cast<size_t>(std::min<uint64_t>(SIEVE_SEGMENT_SIZE, (hi_ - segment_low_) / 2 + 1));
+        segment_.resize(SIEVE_SEGMENT_SIZE);
+        SieveOddWindow(segment_low_, size_, primes_, next_, segment_);
+        position_ = 0;
+    }
+}
+
+std::vector<uint64_t> FindPrimeCountMany(const std::vector<uint64_t>& queries)
+{
+    PROFILE_ZONE(__FUNCTION__);
+    std::vector<uint64_t> res(queries.size(), 0);
+    std::vector<size_t> order(queries.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::sort(order.begin(), order.end(), [&](size_t i, size_t j) { return queries[i] < queries[j]; });
+
+    size_t q = 0;
+    while (q < order.size() && queries[order[q]] < 3)
+    {
+        res[order[q]] = queries[order[q]] == 2;
+        ++q;
+    }
+    if (q == order.size())
+    {
+        return res;
+    }
+
+    const uint64_t max_n = queries[order.back()];
+    const std::vector<uint32_t> primes = FindPrimesUpTo(static_cast<uint32_t>(IntSqrt(max_n)));
+    std::vector<uint64_t> next;
+    next.reserve(primes.size());
+    std::vector<uint8_t> segment(SIEVE_SEGMENT_SIZE);
+
+    // One sweep up to the largest query; every query inside the current
+    // window takes the running count up to its own position.
+    uint64_t count = 1;
+    for (uint64_t low = 3; q < order.size(); low += 2 * SIEVE_SEGMENT_SIZE)
+    {
+        const size_t size = static_cast<size_t>(std::min<uint64_t>(SIEVE_SEGMENT_SIZE, (max_n - low) / 2 + 1));
+        SieveOddWindow(low, size, primes, next, segment);
+
+        size_t cursor = 0;
+        while (q < order.size() && queries[order[q]] < low + 2 * size)
+        {
+            const size_t end = static_cast<size_t>((queries[order[q]] - low) / 2 + 1);
+            count += std::count(segment.begin() + cursor, segment.begin() + end, 1);
+            cursor = end;
+            res[order[q]] = count;
+            ++q;
+        }
+        count += std::count(segment.begin() + cursor, segment.begin() + size, 1);
+    }
+    return res;
+}
+
+uint64_t FindPrimeCountRange(uint64_t a, uint64_t b)
+{
+    if (b <= a)
+    {
+        return 0;
+    }
+
+    const uint64_t lo = a + 1;
+    const std::vector<uint32_t> primes = FindPrimesUpTo(static_cast<uint32_t>(IntSqrt(b)));
+    return (lo <= 2 && b >= 2) + CountOddPrimes(std::max<uint64_t>(lo, 3) | 1, b, primes);
+}
+
+SmallestFactorTable::SmallestFactorTable(uint32_t n)
+    : limit_(n)
+    , entries_(static_cast<size_t>((uint64_t(n) + 1) / 2), 0)
+{
+    PROFILE_ZONE("SmallestFactorTable::SmallestFactorTable");
+    // Linear sieve over the odd numbers: every odd composite i * p is
+    // written once, from its cofactor i and its smallest prime p <= lpf(i).
+    // Such p never exceeds sqrt(n), so only those primes are kept.
+    const uint64_t root = IntSqrt(n);
+    for (uint64_t i = 3; i <= n; i += 2)
+    {
+        const uint16_t entry = entries_[i / 2];
+        if (entry == 0 && i <= root)
+        {
+            primes_.push_back(static_cast<uint32_t>(i));
+        }
+        const uint64_t lpf = entry == 0 ? i : primes_[entry - 1];
+        for (size_t j = 0; j < primes_.size() && primes_[j] <= lpf && i * primes_[j] <= n; ++j)
+        {
+            entries_[i * primes_[j] / 2] = static_cast<uint16_t>(j + 1);
+        }
+    }
+}
+
+uint64_t SmallestFactorTable::CountPrimes() const
+{
+    if (limit_ < 2)
+    {
+        return 0;
+    }
+    // entries_[0] stands for 1, which is not a prime
+    return 1 + std::count(entries_.begin() + 1, entries_.end(), 0);
+}
+
+uint32_t SmallestFactorTable::SmallestFactor(uint32_t k) const
+{
+    assert(k >= 2 && k <= limit_);
+    if (k % 2 == 0)
+    {
+        return 2;
+    }
+    const uint16_t entry = entries_[k / 2];
+    return entry == 0 ? k : primes_[entry - 1];
+}
+
+namespace
+{
+    // A non-trivial factor of the odd composite n, by Pollard's rho with
+    // Brent's cycle detection. The gcd is taken once per block of steps on
+    // the product of the differences, and the block is walked again one
+    // step at a time when the product collapsed to 0 mod n.
+    uint64_t PollardBrent(uint64_t n)
+    {
+        constexpr uint64_t BLOCK = 128;
+        const Montgomery64 mont(n);
+        for (uint64_t c = 1; ; ++c)
+        {
+            const uint64_t shift = mont.To(c);
+            auto f = [&](uint64_t v) { return mont.Add(mont.Mul(v, v), shift); };
+            auto distance = [](uint64_t a, uint64_t b) { return a > b ? a - b : b - a; };
+
+            uint64_t y = mont.To(2), x = y, saved = y;
+            uint64_t product = mont.One();
+            uint64_t g = 1;
+            for (uint64_t r = 1; g == 1; r *= 2)
+            {
+                x = y;
+                for (uint64_t i = 0; i < r; ++i)
+                {
+                    y = f(y);
+                }
+                for (uint64_t k = 0; k < r && g == 1; k += BLOCK)
+                {
+                    saved = y;
+                    for (uint64_t i = 0; i < std::min(BLOCK, r - k); ++i)
+                    {
+                        y = f(y);
+                        product = mont.Mul(product, distance(x, y));
+                    }
+                    g = std::gcd(product, n);
+                }
+            }
+            if (g == n)
+            {
+                do
+                {
+                    saved = f(saved);
+                    g = std::gcd(distance(x, saved), n);
+                } while (g == 1);
+            }
+            if (g != n)
+            {
+                return g;
+            }
+        }
+    }
+}
+
+std::vector<uint64_t> SmallestFactorTable::Factorize(uint64_t k) const
+{
+    std::vector<uint64_t> res;
+    if (k < 2)
+    {
+        return res;
+    }
+    const int twos = std::countr_zero(k);
+    res.assign(twos, 2);
+    k >>= twos;
+
+    // odd cofactors above the table are split by Pollard's rho until
+    // every part is a prime or small enough to look up
+    std::vector<uint64_t> pending;
+    if (k > 1)
+    {
+        pending.push_back(k);
+    }
+    while (!pending.empty())
+    {
+        uint64_t m = pending.back();
+        pending.pop_back();
+        if (m <= limit_)
+        {
+            while (m > 1)
+            {
+                const uint32_t p = SmallestFactor(static_cast<uint32_t>(m));
+                res.push_back(p);
+                m /= p;
+            }
+        }
+        else if (IsPrimeMillerRabin(m))
+        {
+            res.push_back(m);
+        }
+        else
+        {
+            const uint64_t d = PollardBrent(m);
+            pending.push_back(d);
+            pending.push_back(m / d);
+        }
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+std::vector<std::vector<uint64_t>> SmallestFactorTable::FactorizeMany(const std::vector<uint64_t>& values) const
+{
+    std::vector<std::vector<uint64_t>> res;
+    res.reserve(values.size());
+    for (uint64_t value : values)
+    {
+        res.push_back(Factorize(value));
+    }
+    return res;
+}
+
+namespace
+{
+    // Smallest prime factor of a number k of a sieve window, with the
+    // cofactor k / prime and whether prime divides the cofactor again.
+    // prime is 0 if k has no prime factor up to sqrt(n).
+    struct WindowFactor
+    {
+        uint32_t cofactor;
+        uint16_t prime;
+        uint16_t repeated;
+    };
+
+    // Next multiple of a sieving prime: cofactor * prime, with the
+    // cofactor's residue modulo prime kept alongside to avoid divisions.
+    struct FactorMultiple
+    {
+        uint32_t cofactor;
+        uint32_t residue;
+    };
+
+    // f(0) = 0 and f(1) = 1 for every function of the tables
+    template <typename T>
+    void StartTable(std::span<T> table, uint32_t n)
+    {
+        if (table.empty())
+        {
+            return;
+        }
+        assert(table.size() > n);
+        table[0] = 0;
+        if (n >= 1)
+        {
+            table[1] = 1;
+        }
+    }
+
+    // table[k] = value(k, window[k - low]) for k in [low, high]
+    template <typename T, typename F>
+    void SweepTable(std::span<T> table, const std::vector<WindowFactor>& window, uint64_t low, uint64_t high, F value)
+    {
+        if (table.empty())
+        {
+            return;
+        }
+        for (uint64_t k = low; k <= high; ++k)
+        {
+            table[k] = value(k, window[k - low]);
+        }
+    }
+}
+
+void FillMultiplicativeTables(uint32_t n, const MultiplicativeTables& tables)
+{
+    PROFILE_ZONE(__FUNCTION__);
+    const auto phi = tables.phi;
+    const auto mu = tables.mu;
+    const auto count = tables.divisor_count;
+    const auto sum = tables.divisor_sum;
+    StartTable(phi, n);
+    StartTable(mu, n);
+    StartTable(count, n);
+    StartTable(sum, n);
+    if (n < 2)
+    {
+        return;
+    }
+
+    const std::vector<uint32_t> primes = FindPrimesUpTo(static_cast<uint32_t>(IntSqrt(n)));
+    std::vector<FactorMultiple> next(primes.size());
+    for (size_t j = 0; j < primes.size(); ++j)
+    {
+        next[j] = { primes[j], 0 };
+    }
+
+    std::vector<WindowFactor> window(static_cast<size_t>(std::min<uint64_t>(SIEVE_SEGMENT_SIZE, n - 1)));
+    for (uint64_t low = 2; low <= n; low += SIEVE_SEGMENT_SIZE)
+    {
+        const uint64_t high = std::min<uint64_t>(n, low + SIEVE_SEGMENT_SIZE - 1);
+        std::fill_n(window.begin(), high - low + 1, WindowFactor{});
+
+        // Largest primes first, so that the smallest prime of every number
+        // is the last one written
+        const size_t active = std::upper_bound(primes.begin(), primes.end(), IntSqrt(high)) - primes.begin();
+        for (size_t j = active; j-- > 0;)
+        {
+            const uint32_t p = primes[j];
+            uint32_t cofactor = next[j].cofactor;
+            uint32_t residue = next[j].residue;
+            for (uint64_t k = uint64_t(cofactor) * p; k <= high; k += p)
+            {
+                window[k - low] = { cofactor, static_cast<uint16_t>(p), residue == 0 };
+                ++cofactor;
+                residue = residue + 1 == p ? 0 : residue + 1;
+            }
+            next[j] = { cofactor, residue };
+        }
+
+        // k = p * i: with p not dividing i f(k) = f(p) f(i), otherwise the
+        // recurrences along the powers of p, d(k) = 2 d(i) - d(i / p) and
+        // sigma(k) = (p + 1) sigma(i) - p sigma(i / p)
+        SweepTable(phi, window, low, high, [phi](uint64_t k, WindowFactor f) -> uint32_t
+            {
+                if (f.prime == 0)
+                {
+                    return static_cast<uint32_t>(k - 1);
+                }
+                return phi[f.cofactor] * (f.repeated ? f.prime : f.prime - 1u);
+            });
+        SweepTable(mu, window, low, high, [mu](uint64_t, WindowFactor f) -> int8_t
+            {
+                if (f.prime == 0)
+                {
+                    return -1;
+                }
+                return f.repeated ? 0 : -mu[f.cofactor];
+            });
+        SweepTable(count, window, low, high, [count](uint64_t, WindowFactor f) -> uint16_t
+            {
+                if (f.prime == 0)
+                {
+                    return 2;
+                }
+                const uint16_t twice = static_cast<uint16_t>(2 * count[f.cofactor]);
+                return f.repeated ? twice - count[f.cofactor / f.prime] : twice;
+            });
+        SweepTable(sum, window, low, high, [sum](uint64_t k, WindowFactor f) -> uint64_t
+            {
+                if (f.prime == 0)
+                {
+                    return k + 1;
+                }
+                const uint64_t scaled = sum[f.cofactor] * (f.prime + 1);
+                return f.repeated ? scaled - f.prime * sum[f.cofactor / f.prime] : scaled;
+            });
+    }
+}
+
+namespace
+{
+    template <typename T>
+    using AddScaledRowKernel = void (*)(T*, const T*, const T&, size_t);
+
+#ifdef ALGO_X64
+    TARGET("avx2,fma")
+    void AddScaledRowAvx2(double* dst, const double* src, const double& scalar, size_t count)
+    {
+        const __m256d s = _mm256_set1_pd(scalar);
+        size_t j = 0;
+        for (; j + 4 <= count; j += 4)
+        {
+            const __m256d d = _mm256_loadu_pd(dst + j);
+            const __m256d v = _mm256_loadu_pd(src + j);
+            _mm256_storeu_pd(dst + j, _mm256_fmadd_pd(s, v, d));
+        }
+        for (; j < count; ++j)
+        {
+            dst[j] += scalar * src[j];
+        }
+    }
+
+    // AVX2 has no 64-bit multiply, the low 64 bits are put together from
+    // three 32 x 32 -> 64 products.
+    TARGET("avx2")
+    void AddScaledRowAvx2(uint64_t* dst, const uint64_t* src, const uint64_t& scalar, size_t count)
+    {
+        const __m256i s_lo = _mm256_set1_epi64x(static_cast<long long>(scalar));
+        const __m256i s_hi = _mm256_set1_epi64x(static_cast<long long>(scalar >> 32));
+        size_t j = 0;
+        for (; j + 4 <= count; j += 4)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + j));
+            const __m256i lo = _mm256_mul_epu32(v, s_lo);
+            const __m256i cross = _mm256_add_epi64(
+                _mm256_mul_epu32(_mm256_srli_epi64(v, 32), s_lo),
+                _mm256_mul_epu32(v, s_hi));
+            const __m256i prod = _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+            __m256i* out = reinterpret_cast<__m256i*>(dst + j);
+            _mm256_storeu_si256(out, _mm256_add_epi64(_mm256_loadu_si256(out), prod));
+        }
+        for (; j < count; ++j)
+        {
+            dst[j] += scalar * src[j];
+        }
+    }
+
+    bool HasAvx2Fma()
+    {
+#if defined(__GNUC__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        const int max_leaf = info[0];
+        __cpuid(info, 1);
+        const bool fma = (info[2] >> 12) & 1;
+        const bool osxsave = (info[2] >> 27) & 1;
+        // the OS must save the YMM state (XCR0 bits 1-2)
+        if (max_leaf < 7 || !fma || !osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] >> 5) & 1;
+#else
+        return false;
+#endif
+    }
+#endif
+
+    template <typename T>
+    AddScaledRowKernel<T> SelectAddScaledRow()
+    {
+#ifdef ALGO_X64
+        if (HasAvx2Fma())
+        {
+            return AddScaledRowAvx2;
+        }
+#endif
+        return matrix_kernel::AddScaledRow<T>;
+    }
+}
+
+void matrix_kernel::AddScaledRow(double* dst, const double* src, const double& scalar, size_t count)
+{
+    static const AddScaledRowKernel<double> kernel = SelectAddScaledRow<double>();
+    kernel(dst, src, scalar, count);
+}
+
+void matrix_kernel::AddScaledRow(uint64_t* dst, const uint64_t* src, const uint64_t& scalar, size_t count)
+{
+    static const AddScaledRowKernel<uint64_t> kernel = SelectAddScaledRow<uint64_t>();
+    kernel(dst, src, scalar, count);
+}
@@ -1,6 +1,17 @@
 #pragma once
 
+#include <array>
+#include <utility>
+#include <initializer_list>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <vector>
+
 #include "lint.hpp"
+#include "ThreadPool.hpp"
 
 double PowNaive(double n, size_t pow);
 double PowMult(double n, size_t pow);
@@ -10,9 +21,15 @@ apa::lint FibNaive(apa::lint n);
 apa::lint FibIter(apa::lint n);
 size_t FibGoldenRatio(size_t n);
 size_t FibMatrix(size_t n);
+apa::lint FibFastDoubling(size_t n);
 
 bool IsPrimeNaive(size_t n);
 bool IsPrimeOnlyPrimesDivision(size_t n, std::vector<size_t>& primes);
+// Deterministic Miller-Rabin for every 64-bit n, with trial division by the
+// primes below 59 first.
+bool IsPrimeMillerRabin(uint64_t n);
+// IsPrimeMillerRabin for many numbers at once, 1 for prime and 0 otherwise.
+std::vector<uint8_t> IsPrimeMany(const std::vector<uint64_t>& values);
 size_t FindPrimeCountNaive(size_t n);
 size_t FindPrimeCountDivPrime(size_t n);
 
@@ -20,101 +37,485 @@ int FindPrimeCountSieve(int n);
 int FindPrimeCountSieveLinear(int n);
 int FindPrimeCountSieveCompact(int n);
 
-template <typename T>
+// floor(sqrt(n)) and floor(cbrt(n)), exact over the whole uint64_t range.
+uint64_t IntSqrt(uint64_t n);
+uint64_t IntCbrt(uint64_t n);
+
+// All primes p <= n in increasing order.
+std::vector<uint32_t> FindPrimesUpTo(uint32_t n);
+// Sieve of Eratosthenes over odd numbers in cache-sized windows,
+// keeps only the primes up to sqrt(n) in memory.
+uint64_t FindPrimeCountSieveSegmented(uint64_t n);
+// Segmented sieve over the numbers coprime to 30, 8 of them per byte. Each
+// window starts as a copy of a pattern with the multiples of 7, 11, 13
+// and 17 already cleared.
+uint64_t FindPrimeCountSieveWheel(uint64_t n);
+// Lucy_Hedgehog's prime count: O(n^(3/4)) time, O(sqrt(n)) memory.
+uint64_t FindPrimeCountLucy(uint64_t n);
+// Meissel-Lehmer prime count in the Lagarias-Miller-Odlyzko form,
+// O(n^(2/3) log n) time.
+uint64_t FindPrimeCountMeisselLehmer(uint64_t x);
+// pi(n) for every n of queries, answered in the order given, from a single
+// segmented sweep up to the largest n.
+std::vector<uint64_t> FindPrimeCountMany(const std::vector<uint64_t>& queries);
+// pi(b) - pi(a), the number of primes in (a, b]; only that interval is
+// sieved, with the primes up to sqrt(b).
+uint64_t FindPrimeCountRange(uint64_t a, uint64_t b);
+// Segmented sieve with the windows split among the threads of a
+// work-stealing pool; the base primes are shared read-only. Without a
+// pool, one with a thread per core is started for the call.
+uint64_t FindPrimeCountSieveParallel(uint64_t n, ThreadPool* pool = nullptr);
+
+// Smallest prime factor of every number up to n, from a linear sieve over
+// the odd numbers. An odd composite's smallest factor is at most
+// sqrt(n) < 2^16, so it is stored as a 16-bit index into the primes up
+// to sqrt(n), 0 marking a prime: 1 byte per number for n < 2^32.
+class SmallestFactorTable
+{
+public:
+    explicit SmallestFactorTable(uint32_t n);
+
+    uint32_t GetLimit() const
+    {
+        return limit_;
+    }
+
+    uint64_t CountPrimes() const;
+
+    // 2 <= k <= GetLimit()
+    uint32_t SmallestFactor(uint32_t k) const;
+
+    // Prime factors of k in increasing order, repeated by multiplicity.
+    // O(log k) lookups for k up to GetLimit(), Miller-Rabin and Pollard's
+    // rho (Brent) for the parts of larger 64-bit k.
+    std::vector<uint64_t> Factorize(uint64_t k) const;
+    std::vector<std::vector<uint64_t>> FactorizeMany(const std::vector<uint64_t>& values) const;
+
+private:
+    uint32_t limit_;
+    // entries_[k / 2] for odd k
+    std::vector<uint16_t> entries_;
+    std::vector<uint32_t> primes_;
+};
+
+// Output buffers for FillMultiplicativeTables. A buffer that is left empty
+// is not computed; the others need at least n + 1 entries and get f(k) at
+// index k, with 0 at index 0.
+struct MultiplicativeTables
+{
+    // Euler's totient
+    std::span<uint32_t> phi{};
+    // Moebius function
+    std::span<int8_t> mu{};
+    // number of divisors, at most 1344 below 2^32
+    std::span<uint16_t> divisor_count{};
+    // sum of divisors
+    std::span<uint64_t> divisor_sum{};
+};
+
+// Fills the requested tables for every k up to n in one sweep. Each window
+// of the sweep records the smallest prime p of its numbers; f(k) then takes
+// one step from f(k / p), already written to the same buffer. Working
+// memory is one window and the primes up to sqrt(n).
+void FillMultiplicativeTables(uint32_t n, const MultiplicativeTables& tables);
+
+// Primes in [lo, hi] in increasing order, sieved one window ahead of the
+// reader: memory stays at the primes up to sqrt(hi) plus one window.
+// A single-pass input range, usable with range-for and std::ranges views:
+//     for (uint64_t p : PrimeRange(lo, hi)) ...
+class PrimeRange
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_concept = std::input_iterator_tag;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = uint64_t;
+        using difference_type = std::ptrdiff_t;
+        using reference = uint64_t;
+
+        iterator() = default;
+
+        uint64_t operator*() const
+        {
+            return range_->current_;
+        }
+
+        iterator& operator++()
+        {
+            range_->Advance();
+            return *this;
+        }
+
+        void operator++(int)
+        {
+            ++*this;
+        }
+
+        friend bool operator==(const iterator& it, std::default_sentinel_t)
+        {
+            return it.AtEnd();
+        }
+
+    private:
+        friend class PrimeRange;
+
+        bool AtEnd() const
+        {
+            return range_ == nullptr || range_->done_;
+        }
+
+        explicit iterator(PrimeRange* range)
+            : range_(range)
+        {
+        }
+
+        PrimeRange* range_ = nullptr;
+    };
+
+    PrimeRange(uint64_t lo, uint64_t hi);
+
+    iterator begin();
+
+    std::default_sentinel_t end() const
+    {
+        return {};
+    }
+
+private:
+    // Moves current_ to the next prime, sieving the next window when the
+    // current one is used up.
+    void Advance();
+
+    uint64_t hi_;
+    uint64_t current_;
+    bool started_ = false;
+    bool done_ = false;
+    std::vector<uint32_t> primes_;
+    std::vector<uint64_t> next_;
+    std::vector<uint8_t> segment_;
+    // segment_[i] stands for segment_low_ + 2 * i
+    uint64_t segment_low_;
+    size_t size_ = 0;
+    size_t position_ = 0;
+};
+
+// Square matrix. Matrix<T> (N == 0) has its size chosen at run time,
+// Matrix<T, N> keeps its N x N values inline in one std::array.
+template <typename T, size_t N = 0>
 class Matrix
 {
 public:
-    Matrix(const std::vector<std::vector<T>>& values)
+    constexpr Matrix()
+        : values_{}
     {
-        assert(values[0].size() == values.size());
-        values_ = values;
-        size_ = values_.size();
     }
-    Matrix(std::vector<std::vector<T>>&& values)
+
+    constexpr Matrix(std::initializer_list<std::initializer_list<T>> rows)
+        : values_{}
     {
-        assert(values[0].size() == values.size());
-        values_ = std::move(values);
-        size_ = values_.size();
+        assert(rows.size() == N);
+        size_t i = 0;
+        for (const auto& row : rows)
+        {
+            assert(row.size() == N);
+            size_t j = 0;
+            for (const T& value : row)
+            {
+                values_[i * N + j++] = value;
+            }
+            ++i;
+        }
     }
 
-    std::vector<T>& operator[](int i)
+    constexpr T* operator[](size_t i)
     {
-        return values_[i];
+        return values_.data() + i * N;
     }
 
-    const std::vector<T>& operator[](int i) const
+    constexpr const T* operator[](size_t i) const
     {
-        return values_[i];
+        return values_.data() + i * N;
     }
 
-    Matrix operator*(const Matrix& other) const
+    constexpr Matrix operator*(const Matrix& other) const
+    {
+        Matrix res;
+        Multiply(*this, other, res);
+        return res;
+    }
+
+    constexpr Matrix& operator*=(const Matrix& other)
+    {
+        Matrix scratch;
+        Multiply(*this, other, scratch);
+        *this = std::move(scratch);
+        return *this;
+    }
+
+    constexpr Matrix Pow(size_t n) const
+    {
+        Matrix res = *this;
+        res.PowInPlace(n);
+        return res;
+    }
+
+    // *this = (*this)^n with the base, the result and one product kept in
+    // three preallocated matrices which are only swapped, never reallocated.
+    constexpr void PowInPlace(size_t n)
+    {
+        Matrix base = std::move(*this);
+        *this = GetIdm();
+        Matrix scratch;
+        while (n)
+        {
+            if (n % 2 == 1)
+            {
+                Multiply(*this, base, scratch);
+                std::swap(values_, scratch.values_);
+            }
+            n /= 2;
+            if (n)
+            {
+                Multiply(base, base, scratch);
+                std::swap(base.values_, scratch.values_);
+            }
+        }
+    }
+
+    constexpr size_t GetSize() const
     {
-        assert(values_.size() == other.values_.size());
-        std::vector<std::vector<T>> res = values_;
-        for (int i = 0; i < values_.size(); ++i)
+        return N;
+    }
+
+    static constexpr Matrix GetIdm()
+    {
+        Matrix res;
+        for (size_t i = 0; i < N; ++i)
+        {
+            res.values_[i * N + i] = 1;
+        }
+        return res;
+    }
+
+    // out = a * b, out must not alias a or b
+    static constexpr void Multiply(const Matrix& a, const Matrix& b, Matrix& out)
+    {
+        if constexpr (N <= 8)
+        {
+            MultiplyUnrolled(a.values_.data(), b.values_.data(), out.values_.data(), std::make_index_sequence<N * N>{});
+        }
+        else
         {
-            for (int j = 0; j < values_[0].size(); ++j)
+            for (size_t i = 0; i < N; ++i)
             {
-                T cur = 0;
-                for (T k = 0; k < values_[0].size(); ++k)
+                for (size_t j = 0; j < N; ++j)
                 {
-                    cur += values_[i][k] * other.values_[k][j];
+                    T cur = 0;
+                    for (size_t k = 0; k < N; ++k)
+                    {
+                        cur += a.values_[i * N + k] * b.values_[k * N + j];
+                    }
+                    out.values_[i * N + j] = std::move(cur);
                 }
-                res[i][j] = cur;
             }
         }
-        return Matrix(std::move(res));
+    }
+
+private:
+    template <size_t... I>
+    static constexpr void MultiplyUnrolled(const T* a, const T* b, T* out, std::index_sequence<I...>)
+    {
+        ((out[I] = Dot<I / N, I % N>(a, b, std::make_index_sequence<N>{})), ...);
+    }
+
+    template <size_t ROW, size_t COL, size_t... K>
+    static constexpr T Dot(const T* a, const T* b, std::index_sequence<K...>)
+    {
+        return ((a[ROW * N + K] * b[K * N + COL]) + ...);
+    }
+
+    std::array<T, N * N> values_;
+};
+
+// Row update of the blocked Matrix<T> product: dst[j] += scalar * src[j].
+// double and uint64_t go to AVX2 versions on CPUs that have AVX2 and FMA,
+// chosen once at run time; every other element type takes the plain loop.
+namespace matrix_kernel
+{
+    template <typename T>
+    inline void AddScaledRow(T* dst, const T* src, const T& scalar, size_t count)
+    {
+        for (size_t j = 0; j < count; ++j)
+        {
+            dst[j] += scalar * src[j];
+        }
+    }
+
+    void AddScaledRow(double* dst, const double* src, const double& scalar, size_t count);
+    void AddScaledRow(uint64_t* dst, const uint64_t* src, const uint64_t& scalar, size_t count);
+}
+
+template <typename T>
+class Matrix<T, 0>
+{
+public:
+    // Edge of the square blocks the product works on. 64 x 64 doubles take
+    // 32 KiB, so a block of b stays in L1/L2 while a row of out is updated.
+    static inline size_t tile_size = 64;
+
+    Matrix()
+    {
+    }
+
+    explicit Matrix(size_t size)
+        : values_(size * size, T(0))
+        , size_(size)
+    {
+    }
+
+    Matrix(const std::vector<std::vector<T>>& values)
+        : Matrix(values.size())
+    {
+        for (size_t i = 0; i < size_; ++i)
+        {
+            assert(values[i].size() == size_);
+            std::copy(values[i].begin(), values[i].end(), (*this)[i]);
+        }
+    }
+
+    T* operator[](size_t i)
+    {
+        return values_.data() + i * size_;
+    }
+
+    const T* operator[](size_t i) const
+    {
+        return values_.data() + i * size_;
+    }
+
+    Matrix operator*(const Matrix& other) const
+    {
+        Matrix res(size_);
+        Multiply(*this, other, res);
+        return res;
     }
 
     Matrix& operator*=(const Matrix& other)
     {
-        *this = other * (*this);
+        Matrix scratch(size_);
+        Multiply(*this, other, scratch);
+        std::swap(values_, scratch.values_);
         return *this;
     }
 
-    Matrix Pow(int n)
+    Matrix Pow(size_t n, ThreadPool* pool = nullptr) const
     {
-        Matrix res = Matrix::GetIdm(size_);
-        Matrix cur = *this;
+        Matrix res = GetIdm(size_);
+        Matrix base = *this;
+        Matrix scratch(size_);
         while (n)
         {
             if (n % 2 == 1)
             {
-                res *= cur;
-
+                Multiply(res, base, scratch, pool);
+                std::swap(res.values_, scratch.values_);
             }
-            cur *= cur;
             n /= 2;
+            if (n)
+            {
+                Multiply(base, base, scratch, pool);
+                std::swap(base.values_, scratch.values_);
+            }
         }
         return res;
     }
 
-    int GetSize() const
+    size_t GetSize() const
     {
         return size_;
     }
 
-    static Matrix GetIdm(int size)
+    static Matrix GetIdm(size_t size)
     {
-        std::vector<std::vector<T>> val(size, std::vector<T>(size, 0));
-        for (int i = 0; i < size; ++i)
+        Matrix res(size);
+        for (size_t i = 0; i < size; ++i)
         {
-            val[i][i] = 1;
+            res[i][i] = 1;
+        }
+        return res;
+    }
+
+    // out = a * b, out must not alias a or b. The product is computed block
+    // by block; with a pool the output blocks are shared among its threads.
+    static void Multiply(const Matrix& a, const Matrix& b, Matrix& out, ThreadPool* pool = nullptr)
+    {
+        assert(a.size_ == b.size_);
+        const size_t n = a.size_;
+        if (out.size_ != n)
+        {
+            out = Matrix(n);
+        }
+
+        const size_t tile = std::max<size_t>(tile_size, 1);
+        const size_t tiles = (n + tile - 1) / tile;
+        auto multiply_tile = [&](size_t index)
+        {
+            MultiplyTile(a.values_.data(), b.values_.data(), out.values_.data(), n,
+                index / tiles * tile, index % tiles * tile, tile);
+        };
+
+        if (pool != nullptr && tiles * tiles > 1)
+        {
+            pool->ParallelFor(0, tiles * tiles, multiply_tile);
+        }
+        else
+        {
+            for (size_t index = 0; index < tiles * tiles; ++index)
+            {
+                multiply_tile(index);
+            }
         }
-        return Matrix(val);
     }
 
 private:
-    std::vector<std::vector<T>> values_;
+    // Fills the block of out starting at (row_begin, col_begin). Loops run
+    // i-k-j so the innermost one walks rows of b and out contiguously.
+    static void MultiplyTile(const T* a, const T* b, T* out, size_t n,
+        size_t row_begin, size_t col_begin, size_t tile)
+    {
+        const size_t row_end = std::min(row_begin + tile, n);
+        const size_t cols = std::min(col_begin + tile, n) - col_begin;
+        for (size_t i = row_begin; i < row_end; ++i)
+        {
+            std::fill(out + i * n + col_begin, out + i * n + col_begin + cols, T(0));
+        }
+
+        for (size_t k_begin = 0; k_begin < n; k_begin += tile)
+        {
+            const size_t k_end = std::min(k_begin + tile, n);
+            for (size_t i = row_begin; i < row_end; ++i)
+            {
+                T* out_row = out + i * n + col_begin;
+                for (size_t k = k_begin; k < k_end; ++k)
+                {
+                    matrix_kernel::AddScaledRow(out_row, b + k * n + col_begin, a[i * n + k], cols);
+                }
+            }
+        }
+    }
+
+    std::vector<T> values_;
     size_t size_ = 0;
 };
 
-template <typename T>
-std::ostream& operator<<(std::ostream& out, const Matrix<T>& m)
+template <typename T, size_t N>
+std::ostream& operator<<(std::ostream& out, const Matrix<T, N>& m)
 {
-    for (int i = 0; i < m.GetSize(); ++i)
+    for (size_t i = 0; i < m.GetSize(); ++i)
     {
-        for (int j = 0; j < m.GetSize(); ++j)
+        for (size_t j = 0; j < m.GetSize(); ++j)
         {
             out << m[i][j] << ' ';
         }
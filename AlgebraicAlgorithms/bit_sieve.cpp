@@ -0,0 +1,203 @@
+#include <cstring>
+#include <bit>
+
+#include "bit_sieve.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BIT_SIEVE_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit instructions a function is compiled for, MSVC
+// takes any intrinsic anywhere.
+#if defined(__GNUC__)
+#define TARGET(features) __attribute__((target(features)))
+#else
+#define TARGET(features)
+#endif
+
+namespace
+{
+    using CountBitsKernel = uint64_t (*)(const uint8_t*, size_t);
+
+    uint64_t CountTail(const uint8_t* data, size_t bytes)
+    {
+        uint64_t count = 0;
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            count += std::popcount(data[i]);
+        }
+        return count;
+    }
+
+    uint64_t CountBitsPortable(const uint8_t* data, size_t bytes)
+    {
+        uint64_t count = 0;
+        size_t i = 0;
+        for (; i + 8 <= bytes; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            count += std::popcount(word);
+        }
+        return count + CountTail(data + i, bytes - i);
+    }
+
+#ifdef BIT_SIEVE_X64
+    TARGET("popcnt")
+    uint64_t CountBitsPopcnt(const uint8_t* data, size_t bytes)
+    {
+        // four independent sums so the popcnt latency overlaps
+        uint64_t counts[4] = {};
+        size_t i = 0;
+        for (; i + 32 <= bytes; i += 32)
+        {
+            uint64_t words[4];
+            std::memcpy(words, data + i, 32);
+            for (size_t k = 0; k < 4; ++k)
+            {
+#ifdef _MSC_VER
+                counts[k] += __popcnt64(words[k]);
+#else
+                counts[k] += __builtin_popcountll(words[k]);
+#endif
+            }
+        }
+        return counts[0] + counts[1] + counts[2] + counts[3] + CountBitsPortable(data + i, bytes - i);
+    }
+
+    // Per-byte counts from a 16-entry nibble table looked up with vpshufb,
+    // summed into 64-bit lanes with vpsadbw.
+    TARGET("avx2")
+    uint64_t CountBitsAvx2(const uint8_t* data, size_t bytes)
+    {
+        const __m256i table = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_mask = _mm256_set1_epi8(0x0F);
+        __m256i total = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= bytes; i += 32)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            const __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low_mask));
+            const __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+        }
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + CountBitsPortable(data + i, bytes - i);
+    }
+
+    TARGET("avx512f,avx512vpopcntdq")
+    uint64_t CountBitsAvx512(const uint8_t* data, size_t bytes)
+    {
+        __m512i total = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i + 64 <= bytes; i += 64)
+        {
+            total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_loadu_si512(data + i)));
+        }
+        uint64_t lanes[8];
+        _mm512_storeu_si512(lanes, total);
+        uint64_t count = CountBitsPortable(data + i, bytes - i);
+        for (uint64_t lane : lanes)
+        {
+            count += lane;
+        }
+        return count;
+    }
+
+    CountBitsKernel SelectCountBits()
+    {
+#if defined(__GNUC__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+        {
+            return CountBitsAvx512;
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return CountBitsAvx2;
+        }
+        if (__builtin_cpu_supports("popcnt"))
+        {
+            return CountBitsPopcnt;
+        }
+#elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        const int max_leaf = info[0];
+        __cpuid(info, 1);
+        const bool popcnt = (info[2] >> 23) & 1;
+        const bool osxsave = (info[2] >> 27) & 1;
+        // the OS must save the YMM (bits 1-2) and ZMM (bits 5-7) state
+        const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+        if (max_leaf >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            const bool avx2 = (info[1] >> 5) & 1;
+            const bool avx512f = (info[1] >> 16) & 1;
+            const bool vpopcntdq = (info[2] >> 14) & 1;
+            if (avx512f && vpopcntdq && (xcr0 & 0xE6) == 0xE6)
+            {
+                return CountBitsAvx512;
+            }
+            if (avx2 && (xcr0 & 0x6) == 0x6)
+            {
+                return CountBitsAvx2;
+            }
+        }
+        if (popcnt)
+        {
+            return CountBitsPopcnt;
+        }
+#endif
+        return CountBitsPortable;
+    }
+#else
+    CountBitsKernel SelectCountBits()
+    {
+        return CountBitsPortable;
+    }
+#endif
+}
+
+uint64_t CountBits(const void* data, size_t bytes)
+{
+    static const CountBitsKernel kernel = SelectCountBits();
+    return kernel(static_cast<const uint8_t*>(data), bytes);
+}
+
+BitSieve::BitSieve(size_t size, bool value)
+    : words_((size + 63) / 64, value ? ~uint64_t(0) : 0)
+    , size_(size)
+{
+    if (value && size % 64)
+    {
+        words_.back() = (uint64_t(1) << (size % 64)) - 1;
+    }
+}
+
+uint64_t BitSieve::Count(size_t begin, size_t end) const
+{
+    if (begin >= end)
+    {
+        return 0;
+    }
+
+    const size_t first = begin / 64;
+    const size_t last = (end - 1) / 64;
+    const uint64_t first_mask = ~uint64_t(0) << (begin % 64);
+    const uint64_t last_mask = ~uint64_t(0) >> (63 - (end - 1) % 64);
+    if (first == last)
+    {
+        return std::popcount(words_[first] & first_mask & last_mask);
+    }
+    return std::popcount(words_[first] & first_mask)
+        + CountBits(words_.data() + first + 1, (last - first - 1) * sizeof(uint64_t))
+        + std::popcount(words_[last] & last_mask);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Number of set bits in the first `bytes` bytes at data. The kernel is
+// picked once at run time from what the CPU supports: AVX-512 VPOPCNTDQ,
+// AVX2 or the 64-bit popcnt instruction, with a portable loop as the last
+// resort.
+uint64_t CountBits(const void* data, size_t bytes);
+
+// Fixed-size array of flags packed 64 to a word, for sieves that need their
+// survivors counted quickly.
+class BitSieve
+{
+public:
+    explicit BitSieve(size_t size, bool value = true);
+
+    bool operator[](size_t i) const
+    {
+        return (words_[i / 64] >> (i % 64)) & 1;
+    }
+
+    void Set(size_t i)
+    {
+        words_[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    void Reset(size_t i)
+    {
+        words_[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+
+    size_t GetSize() const
+    {
+        return size_;
+    }
+
+    // Set flags in [begin, end)
+    uint64_t Count(size_t begin, size_t end) const;
+
+    uint64_t Count() const
+    {
+        return Count(0, size_);
+    }
+
+private:
+    std::vector<uint64_t> words_;
+    size_t size_;
+};
@@ -1,10 +1,202 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <cmath>
 #include "lint.hpp"
 
 namespace apa
 {
+    static const lint::limb_t POW10[lint::BASE_DIGITS + 1] =
+    {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+
+    namespace
+    {
+        size_t limb_digits(lint::limb_t limb)
+        {
+            size_t digits = 1;
+            while (digits < lint::BASE_DIGITS && limb >= POW10[digits])
+            {
+                ++digits;
+            }
+            return digits;
+        }
+
+        // Writes the lowest `digits` decimal digits of limb (zero padded) and
+        // returns the position after them.
+        char* format_limb(char* out, lint::limb_t limb, size_t digits)
+        {
+            static const char PAIRS[] =
+                "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+
+            char* p = out + digits;
+            while (p - out >= 2)
+            {
+                const char* pair = PAIRS + 2 * (limb % 100);
+                limb /= 100;
+                *--p = pair[1];
+                *--p = pair[0];
+            }
+            if (p != out)
+            {
+                *--p = static_cast<char>('0' + limb % 10);
+            }
+            return out + digits;
+        }
+
+        // Montgomery arithmetic modulo an NTT friendly prime p < 2^30,
+        // values are kept in Montgomery form and fully reduced.
+        struct NttPrime
+        {
+            uint32_t mod;
+            uint32_t root;
+            uint32_t neg_inv;
+            uint32_t r2;
+
+            NttPrime(uint32_t p, uint32_t primitive_root)
+                : mod(p), root(primitive_root)
+            {
+                uint32_t inv = p;
+                for (int i = 0; i < 4; ++i)
+                {
+                    inv *= 2 - p * inv;
+                }
+                neg_inv = 0u - inv;
+                r2 = static_cast<uint32_t>((0ull - p) % p);
+            }
+
+            uint32_t reduce(uint64_t x) const
+            {
+                uint32_t q = static_cast<uint32_t>(x) * neg_inv;
+                uint32_t t = static_cast<uint32_t>((x + static_cast<uint64_t>(q) * mod) >> 32);
+                return t >= mod ? t - mod : t;
+            }
+
+            uint32_t mul(uint32_t a, uint32_t b) const
+            {
+                return reduce(static_cast<uint64_t>(a) * b);
+            }
+
+            uint32_t add(uint32_t a, uint32_t b) const
+            {
+                uint32_t s = a + b;
+                return s >= mod ? s - mod : s;
+            }
+
+            uint32_t sub(uint32_t a, uint32_t b) const
+            {
+                return a >= b ? a - b : a + mod - b;
+            }
+
+            uint32_t to_mont(uint32_t a) const
+            {
+                return mul(a % mod, r2);
+            }
+
+            uint32_t pow(uint32_t a, uint64_t e) const
+            {
+                uint32_t res = to_mont(1);
+                while (e)
+                {
+                    if (e & 1)
+                    {
+                        res = mul(res, a);
+                    }
+                    a = mul(a, a);
+                    e >>= 1;
+                }
+                return res;
+            }
+
+            // roots[len + j] = w^j for the primitive (2 len)-th root of unity w
+            vector<uint32_t> roots(size_t size, bool inverse) const
+            {
+                vector<uint32_t> result(std::max<size_t>(size, 2));
+                for (size_t len = 1; len < size; len <<= 1)
+                {
+                    uint32_t w = pow(to_mont(root), (mod - 1) / (2 * len));
+                    if (inverse)
+                    {
+                        w = pow(w, mod - 2);
+                    }
+                    result[len] = to_mont(1);
+                    for (size_t j = 1; j < len; ++j)
+                    {
+                        result[len + j] = mul(result[len + j - 1], w);
+                    }
+                }
+                return result;
+            }
+
+            // Decimation in frequency, leaves the spectrum in bit reversed order.
+            void forward(vector<uint32_t>& a, const vector<uint32_t>& roots) const
+            {
+                for (size_t len = a.size() / 2; len >= 1; len >>= 1)
+                {
+                    for (size_t i = 0; i < a.size(); i += 2 * len)
+                    {
+                        for (size_t j = 0; j < len; ++j)
+                        {
+                            uint32_t u = a[i + j];
+                            uint32_t v = a[i + j + len];
+                            a[i + j] = add(u, v);
+                            a[i + j + len] = mul(sub(u, v), roots[len + j]);
+                        }
+                    }
+                }
+            }
+
+            // Decimation in time from bit reversed order, includes the 1 / size scaling.
+            void inverse(vector<uint32_t>& a, const vector<uint32_t>& inverse_roots) const
+            {
+                for (size_t len = 1; len < a.size(); len <<= 1)
+                {
+                    for (size_t i = 0; i < a.size(); i += 2 * len)
+                    {
+                        for (size_t j = 0; j < len; ++j)
+                        {
+                            uint32_t u = a[i + j];
+                            uint32_t v = mul(a[i + j + len], inverse_roots[len + j]);
+                            a[i + j] = add(u, v);
+                            a[i + j + len] = sub(u, v);
+                        }
+                    }
+                }
+
+                uint32_t size_inv = pow(to_mont(static_cast<uint32_t>(a.size() % mod)), mod - 2);
+                for (uint32_t& x : a)
+                {
+                    x = reduce(mul(x, size_inv));
+                }
+            }
+        };
+
+        // The product of the three primes (~5.9e25) bounds every coefficient
+        // of a convolution of 2^24 limbs below 10^9 (~1.7e25).
+        const uint32_t NTT_P1 = 754974721;
+        const uint32_t NTT_P2 = 167772161;
+        const uint32_t NTT_P3 = 469762049;
+
+        uint64_t pow_mod(uint64_t a, uint64_t e, uint64_t mod)
+        {
+            uint64_t res = 1;
+            a %= mod;
+            while (e)
+            {
+                if (e & 1)
+                {
+                    res = res * a % mod;
+                }
+                a = a * a % mod;
+                e >>= 1;
+            }
+            return res;
+        }
+    }
+
     lint::lint(std::string number)
     {
         string_to_vector(number);
@@ -34,22 +226,38 @@ namespace apa
 
     lint::lint(vector<int> nums, bool is_neg)
     {
-        numbers = nums;
-        is_negative = is_neg;
-    }
-
-    lint::lint(const lint &obj) {
-        is_negative = obj.is_negative_number();
+        std::string digits;
+        digits.reserve(nums.size());
 
-        for (int t : obj.numbers)
+        for (int d : nums)
         {
-            numbers.push_back(t);
+            digits.push_back(static_cast<char>('0' + d));
         }
+
+        string_to_vector(digits);
+        is_negative = is_neg && !limbs.empty();
+    }
+
+    lint::lint(const lint &obj)
+        : is_negative(obj.is_negative), limbs(obj.limbs)
+    {
+    }
+
+    lint::lint(lint&& obj) noexcept
+        : is_negative(obj.is_negative), limbs(std::move(obj.limbs))
+    {
+        obj.limbs.clear();
+        obj.is_negative = false;
     }
 
     int lint::get_length() const
     {
-        return numbers.size();
+        if (limbs.empty())
+        {
+            return 1;
+        }
+
+        return static_cast<int>((limbs.size() - 1) * BASE_DIGITS + limb_digits(limbs.back()));
     }
 
     bool lint::is_negative_number() const
@@ -57,616 +265,1014 @@ namespace apa
         return is_negative;
     }
 
+    const lint::limb_vector& lint::get_limbs() const
+    {
+        return limbs;
+    }
+
     lint& lint::operator+=(const lint& b)
     {
-        if (!is_negative_number() && b.is_negative_number())
+        add_signed(*this, *this, b, false);
+        return *this;
+    }
+
+    lint& lint::operator-=(const lint& b)
+    {
+        add_signed(*this, *this, b, true);
+        return *this;
+    }
+
+    void add_to(lint& dst, const lint& a, const lint& b)
+    {
+        lint::add_signed(dst, a, b, false);
+    }
+
+    void sub_to(lint& dst, const lint& a, const lint& b)
+    {
+        lint::add_signed(dst, a, b, true);
+    }
+
+    lint& lint::operator*=(const lint& number2)
+    {
+        limbs = mul_abs(limbs, number2.limbs);
+        is_negative = !limbs.empty() && (is_negative != number2.is_negative);
+
+        return *this;
+    }
+
+    lint& lint::operator/=(const lint& number2)
+    {
+        if (number2.is_zero())
         {
-            lint temp(b);
-            temp = abs(temp);
+            throw std::domain_error("apa::lint division by zero");
+        }
+
+        limb_vector remainder;
+        divmod_abs(limb_vector(limbs), number2.limbs, limbs, remainder);
+        is_negative = !limbs.empty() && (is_negative != number2.is_negative);
+
+        return *this;
+    }
 
-            return operator-=(temp);
+    lint& lint::operator%=(const lint& number2)
+    {
+        if (number2.is_zero())
+        {
+            throw std::domain_error("apa::lint division by zero");
         }
 
-        if (is_negative_number() && !b.is_negative_number())
+        limb_vector quotient;
+        divmod_abs(limb_vector(limbs), number2.limbs, quotient, limbs);
+        is_negative = is_negative && !limbs.empty();
+
+        return *this;
+    }
+
+    std::pair<lint, lint> divmod(const lint& a, const lint& b)
+    {
+        if (b.is_zero())
         {
-            lint temp_this = lint(*this);
-            temp_this.is_negative = false;
+            throw std::domain_error("apa::lint division by zero");
+        }
+
+        std::pair<lint, lint> result;
+        lint::divmod_abs(a.limbs, b.limbs, result.first.limbs, result.second.limbs);
+        result.first.is_negative = !result.first.limbs.empty() && (a.is_negative != b.is_negative);
+        result.second.is_negative = !result.second.limbs.empty() && a.is_negative;
+
+        return result;
+    }
+
+    lint::operator bool() const
+    {
+        return !is_zero();
+    }
+
+    lint::operator int()
+    {
+        return std::stoi((*this).to_string());
+    }
+
+    lint lint::operator+() const
+    {
+        lint temp(*this);
+        return temp;
+    }
 
-            lint temp = lint(b);
-            temp -= temp_this;
-            *this = temp;
+    lint lint::operator-() const
+    {
+        lint temp(*this);
+        temp.is_negative = !is_negative && !is_zero();
+        return temp;
+    }
+
+    int lint::operator[](size_t index) const
+    {
+        size_t position = static_cast<size_t>(get_length()) - 1 - index;
+        return static_cast<int>(limbs.empty() ? 0 : (limbs[position / BASE_DIGITS] / POW10[position % BASE_DIGITS]) % 10);
+    }
 
-            return *this;
+    lint& lint::operator=(const lint& other)
+    {
+        if (this != &other)
+        {
+            limbs = other.limbs;
+            is_negative = other.is_negative_number();
         }
+        return *this;
+    }
 
-        vector<int> number1;
-        vector<int> number2;
+    lint& lint::operator=(lint&& other) noexcept
+    {
+        if (this != &other)
+        {
+            limbs.swap(other.limbs);
+            is_negative = other.is_negative;
+            other.limbs.clear();
+            other.is_negative = false;
+        }
+        return *this;
+    }
 
-        make_equal_length(b, number1, number2);
+    lint& lint::operator++()
+    {
+        if (is_negative)
+        {
+            decrement_abs(limbs);
+            is_negative = !limbs.empty();
+        }
+        else
+        {
+            increment_abs(limbs);
+        }
+        return *this;
+    }
 
-        vector<int> result;
-        int rest = 0;
+    lint lint::operator++(int) {
+        lint tmp(*this);
+        operator++();
+        return tmp;
+    }
 
-        for (int i = number1.size() - 1; i >= 0; --i)
+    lint& lint::operator--()
+    {
+        if (is_negative || limbs.empty())
+        {
+            increment_abs(limbs);
+            is_negative = true;
+        }
+        else
         {
-            int sum = number1[i] + number2[i] + rest;
+            decrement_abs(limbs);
+        }
+        return *this;
+    }
 
-            if (sum > 9)
-            {
-                rest = 1;
-                sum -= 10;
-            }
-            else
+    lint lint::operator--(int) {
+        lint tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    bool lint::cmp(lint const& rhs) const
+    {
+        return compare(rhs) < 0;
+    }
+
+    int lint::compare(lint const& rhs) const
+    {
+        if (is_negative != rhs.is_negative)
+        {
+            return is_negative ? -1 : 1;
+        }
+
+        int result = compare_abs(limbs, rhs.limbs);
+        return is_negative ? -result : result;
+    }
+
+    int lint::compare_abs(lint const& rhs) const
+    {
+        return compare_abs(limbs, rhs.limbs);
+    }
+
+    lint lint::abs(lint number) const
+    {
+        number.is_negative = false;
+        return number;
+    }
+
+    bool lint::is_zero() const
+    {
+        return limbs.empty();
+    }
+
+    std::string lint::to_string() const
+    {
+        if (limbs.empty())
+        {
+            return "0";
+        }
+
+        const size_t top_digits = limb_digits(limbs.back());
+        std::string result((is_negative ? 1 : 0) + top_digits + (limbs.size() - 1) * BASE_DIGITS, '0');
+        char* out = result.data();
+
+        if (is_negative)
+        {
+            *out++ = '-';
+        }
+
+        out = format_limb(out, limbs.back(), top_digits);
+
+        for (size_t i = limbs.size() - 1; i-- > 0;)
+        {
+            out = format_limb(out, limbs[i], BASE_DIGITS);
+        }
+
+        return result;
+    }
+
+    void lint::trim()
+    {
+        while (!limbs.empty() && limbs.back() == 0)
+        {
+            limbs.pop_back();
+        }
+
+        if (limbs.empty())
+        {
+            is_negative = false;
+        }
+    }
+
+    int lint::compare_abs(limb_vector const& a, limb_vector const& b)
+    {
+        if (a.size() != b.size())
+        {
+            return a.size() < b.size() ? -1 : 1;
+        }
+
+        for (size_t i = a.size(); i-- > 0;)
+        {
+            if (a[i] != b[i])
             {
-                rest = 0;
+                return a[i] < b[i] ? -1 : 1;
             }
+        }
+
+        return 0;
+    }
+
+    void lint::add_abs(limb_vector& a, limb_vector const& b)
+    {
+        add_abs_to(a, a, b);
+    }
+
+    // a -= b, requires |a| >= |b|
+    void lint::sub_abs(limb_vector& a, limb_vector const& b)
+    {
+        sub_abs_to(a, a, b);
+    }
 
-            result.push_back(sum);
+    // dst = a + b or a - b, dst may alias a and b and keeps its capacity
+    void lint::add_signed(lint& dst, const lint& a, const lint& b, bool negate_b)
+    {
+        const bool b_negative = b.is_negative != negate_b;
+
+        if (a.is_negative == b_negative)
+        {
+            add_abs_to(dst.limbs, a.limbs, b.limbs);
+            dst.is_negative = a.is_negative && !dst.limbs.empty();
+            return;
+        }
+
+        int cmp_abs = compare_abs(a.limbs, b.limbs);
+
+        if (cmp_abs == 0)
+        {
+            dst.limbs.clear();
+            dst.is_negative = false;
+        }
+        else if (cmp_abs > 0)
+        {
+            const bool negative = a.is_negative;
+            sub_abs_to(dst.limbs, a.limbs, b.limbs);
+            dst.is_negative = negative;
+        }
+        else
+        {
+            sub_abs_to(dst.limbs, b.limbs, a.limbs);
+            dst.is_negative = b_negative;
         }
+    }
+
+    // dst = |a| + |b|, dst may alias a and b
+    void lint::add_abs_to(limb_vector& dst, limb_vector const& a, limb_vector const& b)
+    {
+        const size_t common = std::min(a.size(), b.size());
+        limb_vector const& longer = a.size() >= b.size() ? a : b;
+        const size_t n = longer.size();
 
-        if (rest > 0)
+        // Growing dst only appends zeros, so aliased operands keep their values.
+        if (dst.size() < n)
         {
-            result.push_back(rest);
+            dst.resize(n, 0);
         }
 
-        vector<int> reverse_result = reverse_numbers(result);
+        // Branch free carries, the carry pattern of random limbs is unpredictable.
+        limb_t carry = 0;
+        size_t i = 0;
 
-        (*this).numbers = reverse_result;
+        for (; i < common; ++i)
+        {
+            limb_t sum = a[i] + b[i] + carry;
+            carry = sum >= BASE;
+            dst[i] = sum - carry * BASE;
+        }
 
-        return *this;
+        // In place the untouched tail is already there once the carry dies out.
+        const bool in_place = &dst == &longer;
+
+        for (; i < n && !(in_place && carry == 0); ++i)
+        {
+            limb_t sum = longer[i] + carry;
+            carry = sum >= BASE;
+            dst[i] = sum - carry * BASE;
+        }
+
+        dst.resize(n);
+
+        if (carry)
+        {
+            dst.push_back(carry);
+        }
     }
 
-    lint& lint::operator-=(const lint& b)
+    // dst = |a| - |b|, requires |a| >= |b|, dst may alias a and b
+    void lint::sub_abs_to(limb_vector& dst, limb_vector const& a, limb_vector const& b)
     {
-        if (!is_negative_number() && b.is_negative_number())
+        const size_t na = a.size();
+        const size_t nb = b.size();
+
+        if (dst.size() < na)
         {
-            return (*this).operator+=(abs(b));
+            dst.resize(na, 0);
         }
 
-        if (is_negative_number() && !b.is_negative_number())
+        limb_t borrow = 0;
+        size_t i = 0;
+
+        for (; i < nb; ++i)
         {
-            lint temp(b);
-            temp.is_negative = true;
-            return (*this).operator+=(temp);
+            limb_t sub = b[i] + borrow;
+            limb_t cur = a[i];
+            borrow = cur < sub;
+            dst[i] = cur - sub + borrow * BASE;
         }
 
-        vector<int> number1;
-        vector<int> number2;
+        const bool in_place = &dst == &a;
 
-        make_equal_length(b, number1, number2);
+        for (; i < na && !(in_place && borrow == 0); ++i)
+        {
+            limb_t cur = a[i];
+            limb_t next_borrow = cur < borrow;
+            dst[i] = cur - borrow + next_borrow * BASE;
+            borrow = next_borrow;
+        }
 
-        int is_number1_more_than_number2 = 0;
+        dst.resize(na);
 
-        for (unsigned int i = 0; i < number1.size(); ++i)
+        while (!dst.empty() && dst.back() == 0)
         {
-            if (number1[i] > number2[i])
+            dst.pop_back();
+        }
+    }
+
+    void lint::increment_abs(limb_vector& a)
+    {
+        for (limb_t& limb : a)
+        {
+            if (++limb < BASE)
             {
-                is_number1_more_than_number2 = 1;
-                break;
+                return;
             }
-            else if (number1[i] < number2[i])
+            limb = 0;
+        }
+        a.push_back(1);
+    }
+
+    // requires a != 0
+    void lint::decrement_abs(limb_vector& a)
+    {
+        for (limb_t& limb : a)
+        {
+            if (limb-- > 0)
             {
-                is_number1_more_than_number2 = 2;
                 break;
             }
+            limb = BASE - 1;
         }
 
-        if (is_number1_more_than_number2 == 0)
+        while (!a.empty() && a.back() == 0)
         {
-            vector<int> t;
-            t.push_back(0);
-            numbers = t;
-            return *this;
+            a.pop_back();
         }
+    }
 
-        vector<int> result;
+    lint::limb_vector lint::mul_abs(limb_vector const& a, limb_vector const& b)
+    {
+        return mul_limbs(a.data(), a.size(), b.data(), b.size());
+    }
 
-        if (is_number1_more_than_number2 == 1)
+    lint::limb_vector lint::mul_limbs(const limb_t* a, size_t n, const limb_t* b, size_t m)
+    {
+        while (n > 0 && a[n - 1] == 0)
         {
-            for (int i = number1.size() - 1; i >= 0; --i)
-            {
-                if (number1[i] < number2[i])
-                {
-                    number1[i] += 10;
-                    number1[i - 1] -= 1;
-                }
-
-                int r = number1[i] - number2[i];
-
-                result.push_back(r);
-            }
+            --n;
         }
-        else if (is_number1_more_than_number2 == 2)
+
+        while (m > 0 && b[m - 1] == 0)
         {
-            for (int i = number2.size() - 1; i >= 0; --i)
-            {
-                if (number2[i] < number1[i])
-                {
-                    number2[i] += 10;
-                    number2[i - 1] -= 1;
-                }
+            --m;
+        }
 
-                int r = number2[i] - number1[i];
+        if (n < m)
+        {
+            std::swap(a, b);
+            std::swap(n, m);
+        }
 
-                result.push_back(r);
-            }
+        if (m == 0)
+        {
+            return {};
         }
 
-        bool can_copy = false;
-        vector<int> result_without_zero;
+        if (m < std::max<size_t>(karatsuba_threshold, 2))
+        {
+            return mul_schoolbook(a, n, b, m);
+        }
 
-        for (int i = result.size() - 1; i >= 0; --i)
+        // Unbalanced operands: multiply b by m-sized chunks of a so that
+        // every recursive product is balanced.
+        if (2 * m <= n)
         {
-            if (result[i] != 0)
+            limb_vector c(n + m, 0);
+
+            for (size_t offset = 0; offset < n; offset += m)
             {
-                can_copy = true;
+                size_t len = std::min(m, n - offset);
+                add_at(c, mul_limbs(a + offset, len, b, m), offset);
             }
 
-            if (can_copy)
+            while (!c.empty() && c.back() == 0)
             {
-                result_without_zero.push_back(result[i]);
+                c.pop_back();
             }
-        }
 
-        (*this).numbers = result_without_zero;
+            return c;
+        }
 
-        if (!is_negative_number() && !b.is_negative_number())
+        if (m >= ntt_threshold && n + m <= NTT_MAX_LENGTH)
         {
-            if (is_number1_more_than_number2 == 2)
-            {
-                is_negative = true;
-            }
+            return mul_ntt(a, n, b, m);
         }
 
-        if (is_negative_number() && b.is_negative_number())
+        if (m >= std::max<size_t>(toom3_threshold, 3))
         {
-            if (is_number1_more_than_number2 == 2)
-            {
-                is_negative = false;
-            }
+            return mul_toom3(a, n, b, m);
         }
 
-        return *this;
+        return mul_karatsuba(a, n, b, m);
     }
 
-    lint& lint::operator*=(const lint& number2)
+    lint::limb_vector lint::mul_schoolbook(const limb_t* a, size_t n, const limb_t* b, size_t m)
     {
-        vector<int> a = reverse_numbers(numbers);
-        vector<int> b = reverse_numbers(number2.numbers);
-
-        vector<int> c(a.size() + b.size(), 0);
+        limb_vector c(n + m, 0);
 
-        for (size_t i = 0; i < a.size(); ++i)
+        for (size_t i = 0; i < n; ++i)
         {
-            int carry = 0;
+            dlimb_t carry = 0;
 
-            for (unsigned int j = 0; j < b.size() || carry; ++j)
+            for (size_t j = 0; j < m; ++j)
             {
-                long long cur = c[i + j] + a[i] * 1ll * (j < b.size() ? b[j] : 0) + carry;
+                dlimb_t cur = c[i + j] + static_cast<dlimb_t>(a[i]) * b[j] + carry;
+
+                c[i + j] = static_cast<limb_t>(cur % BASE);
+                carry = cur / BASE;
+            }
+
+            c[i + m] = static_cast<limb_t>(carry);
+        }
+
+        while (!c.empty() && c.back() == 0)
+        {
+            c.pop_back();
+        }
+
+        return c;
+    }
+
+    // (a1 x + a0)(b1 x + b0) = a1 b1 x^2 + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) x + a0 b0
+    // with x = BASE^k, requires n >= m > n / 2.
+    lint::limb_vector lint::mul_karatsuba(const limb_t* a, size_t n, const limb_t* b, size_t m)
+    {
+        size_t k = (n + 1) / 2;
 
-                c[i + j] = int(cur % 10);
-                carry = int(cur / 10);
-            }
-        }
+        limb_vector z0 = mul_limbs(a, k, b, std::min(k, m));
+        limb_vector z2 = mul_limbs(a + k, n - k, b + std::min(k, m), m - std::min(k, m));
 
-        while (c.size() > 1 && c.back() == 0)
-        {
-            c.pop_back();
-        }
+        limb_vector sum_a(a, a + k);
+        add_abs(sum_a, limb_vector(a + k, a + n));
+        limb_vector sum_b(b, b + std::min(k, m));
+        add_abs(sum_b, limb_vector(b + std::min(k, m), b + m));
 
-        vector<int> result = reverse_numbers(c);
+        limb_vector z1 = a == b && n == m
+            ? mul_limbs(sum_a.data(), sum_a.size(), sum_a.data(), sum_a.size())
+            : mul_limbs(sum_a.data(), sum_a.size(), sum_b.data(), sum_b.size());
+        sub_abs(z1, z0);
+        sub_abs(z1, z2);
 
-        numbers = result;
+        limb_vector c(n + m + 1, 0);
+        add_at(c, z0, 0);
+        add_at(c, z1, k);
+        add_at(c, z2, 2 * k);
 
-        if (is_negative_number() && !number2.is_negative_number())
-        {
-            is_negative = true;
-        }
-        else if (!is_negative_number() && number2.is_negative_number())
+        while (!c.empty() && c.back() == 0)
         {
-            is_negative = true;
-        }
-        else
-        {
-            is_negative = false;
+            c.pop_back();
         }
 
-        return *this;
+        return c;
     }
 
-    lint& lint::operator/=(const lint& number2)
+    // Toom-3 with evaluation points 0, 1, -1, -2, inf and Bodrato's
+    // interpolation sequence, requires n >= m > n / 2.
+    lint::limb_vector lint::mul_toom3(const limb_t* a, size_t n, const limb_t* b, size_t m)
     {
-        if (number2.is_zero())
-        {
-            int d = 4 - 4;
-            int a = 4 / d;
-            numbers.push_back(a);
-        }
+        size_t k = (n + 2) / 3;
 
-        if (is_zero())
+        auto part = [k](const limb_t* p, size_t len, size_t index)
         {
-            vector<int> temp;
-            temp.push_back(0);
-            numbers = temp;
-            is_negative = false;
-            return *this;
+            lint x;
+            size_t from = std::min(len, index * k);
+            size_t to = std::min(len, from + k);
+            x.limbs.assign(p + from, p + to);
+            x.trim();
+            return x;
+        };
+
+        lint a0 = part(a, n, 0), a1 = part(a, n, 1), a2 = part(a, n, 2);
+        lint b0 = part(b, m, 0), b1 = part(b, m, 1), b2 = part(b, m, 2);
+
+        lint pa = a0 + a2;
+        lint pb = b0 + b2;
+
+        lint r0 = a0 * b0;
+        lint r1 = (pa + a1) * (pb + b1);
+        lint rm1 = (pa - a1) * (pb - b1);
+        lint rm2 = ((pa - a1 + a2) * 2 - a0) * ((pb - b1 + b2) * 2 - b0);
+        lint rinf = a2 * b2;
+
+        // rm2 = (r(-2) - r(1)) / 3, r1 = (r(1) - r(-1)) / 2, rm1 = r(-1) - r(0)
+        lint t3 = rm2 - r1;
+        div_small(t3.limbs, 3);
+        lint t1 = r1 - rm1;
+        div_small(t1.limbs, 2);
+        lint t2 = rm1 - r0;
+
+        t3 = t2 - t3;
+        div_small(t3.limbs, 2);
+        t3 += rinf * 2;
+        t2 += t1;
+        t2 -= rinf;
+        t1 -= t3;
+
+        limb_vector c(n + m + 2, 0);
+        add_at(c, r0.limbs, 0);
+        add_at(c, t1.limbs, k);
+        add_at(c, t2.limbs, 2 * k);
+        add_at(c, t3.limbs, 3 * k);
+        add_at(c, rinf.limbs, 4 * k);
+
+        while (!c.empty() && c.back() == 0)
+        {
+            c.pop_back();
         }
 
-        bool second_number_more_then_first_number = abs(*this).cmp(abs(number2));
+        return c;
+    }
 
-        if (second_number_more_then_first_number)
+    // Convolution modulo three primes recombined by Garner's CRT. When a and b
+    // are the same operand the forward transform is done once and squared.
+    lint::limb_vector lint::mul_ntt(const limb_t* a, size_t n, const limb_t* b, size_t m)
+    {
+        const bool square = a == b && n == m;
+        const size_t length = n + m - 1;
+        size_t size = 1;
+        while (size < length)
         {
-            vector<int> temp;
-            temp.push_back(0);
-            numbers = temp;
-            is_negative = false;
-            return *this;
+            size <<= 1;
         }
 
-        vector<int> res;
-        for (int i = (*this).get_length() - 1; i >= 0; --i)
-        {
-            res.push_back(0);
-        }
+        const NttPrime primes[3] = { NttPrime(NTT_P1, 11), NttPrime(NTT_P2, 3), NttPrime(NTT_P3, 3) };
+        vector<uint32_t> residues[3];
 
-        lint current_value(0);
-        for (int i = 0; i < (*this).get_length(); ++i)
+        for (int k = 0; k < 3; ++k)
         {
-            current_value = current_value * 10;
-            current_value.numbers[current_value.get_length() - 1] = (*this).numbers[i];
-
-            int x = 0;
-            int left_index = 0;
-            int right_index = 10;
+            const NttPrime& p = primes[k];
+            vector<uint32_t> fa(size, 0);
+            for (size_t i = 0; i < n; ++i)
+            {
+                fa[i] = p.to_mont(a[i]);
+            }
+            p.forward(fa, p.roots(size, false));
 
-            while (left_index <= right_index)
+            if (square)
+            {
+                for (uint32_t& x : fa)
+                {
+                    x = p.mul(x, x);
+                }
+            }
+            else
             {
-                int middle = (left_index + right_index) >> 1;
-                
-                lint cur = abs(number2) * middle;
-                
-                if (abs(cur) <= abs(current_value))
+                vector<uint32_t> fb(size, 0);
+                for (size_t i = 0; i < m; ++i)
                 {
-                    x = middle;
-                    left_index = middle + 1;
+                    fb[i] = p.to_mont(b[i]);
                 }
-                else 
+                p.forward(fb, p.roots(size, false));
+
+                for (size_t i = 0; i < size; ++i)
                 {
-                    right_index = middle - 1;
+                    fa[i] = p.mul(fa[i], fb[i]);
                 }
             }
 
-            res[i] = x;
-            current_value = current_value - abs(number2) * x;
-        }
-
-        res = reverse_numbers(res);
-
-        while (res.size() > 1 && res.back() == 0)
-        {
-            res.pop_back();
+            p.inverse(fa, p.roots(size, true));
+            fa.resize(length);
+            residues[k] = std::move(fa);
         }
 
-        res = reverse_numbers(res);
+        const uint64_t inv_p1_p2 = pow_mod(NTT_P1, NTT_P2 - 2, NTT_P2);
+        const uint64_t inv_p1_p3 = pow_mod(NTT_P1, NTT_P3 - 2, NTT_P3);
+        const uint64_t inv_p2_p3 = pow_mod(NTT_P2, NTT_P3 - 2, NTT_P3);
+        const uint64_t p1p2 = static_cast<uint64_t>(NTT_P1) * NTT_P2;
+        const uint64_t p1p2_lo = p1p2 % BASE;
+        const uint64_t p1p2_hi = p1p2 / BASE;
 
-        numbers = res;
+        // Every coefficient is spread over three limbs, so each accumulator
+        // slot receives at most three values below BASE.
+        vector<dlimb_t> acc(length + 2, 0);
 
-        if (is_negative_number() && !number2.is_negative_number())
+        for (size_t i = 0; i < length; ++i)
         {
-            is_negative = true;
+            uint64_t v1 = residues[0][i];
+            uint64_t v2 = (residues[1][i] + NTT_P2 - v1 % NTT_P2) % NTT_P2 * inv_p1_p2 % NTT_P2;
+            uint64_t v3 = (residues[2][i] + NTT_P3 - v1 % NTT_P3) % NTT_P3 * inv_p1_p3 % NTT_P3;
+            v3 = (v3 + NTT_P3 - v2 % NTT_P3) % NTT_P3 * inv_p2_p3 % NTT_P3;
+
+            uint64_t t = v1 + v2 * NTT_P1 + v3 * p1p2_lo;
+            acc[i] += t % BASE;
+            t = t / BASE + v3 * p1p2_hi;
+            acc[i + 1] += t % BASE;
+            acc[i + 2] += t / BASE;
         }
-        else if (!is_negative_number() && number2.is_negative_number())
+
+        limb_vector c(acc.size());
+        dlimb_t carry = 0;
+        for (size_t i = 0; i < acc.size(); ++i)
         {
-            is_negative = true;
+            dlimb_t cur = acc[i] + carry;
+            c[i] = static_cast<limb_t>(cur % BASE);
+            carry = cur / BASE;
         }
-        else
+
+        while (!c.empty() && c.back() == 0)
         {
-            is_negative = false;
+            c.pop_back();
         }
 
-        return *this;
-    }
-
-    lint::operator bool() const
-    {
-        return !is_zero();
-    }
-
-    lint::operator int()
-    {
-        return std::stoi((*this).to_string());
-    }
-
-    lint lint::operator+() const
-    {
-        lint temp(*this);
-        return temp;
+        return c;
     }
 
-    lint lint::operator-() const
+    void lint::divmod_abs(limb_vector const& a, limb_vector const& b, limb_vector& q, limb_vector& r)
     {
-        lint temp(*this);
-
-        if (is_negative_number())
+        if (compare_abs(a, b) < 0)
         {
-            temp.is_negative = false;
+            q.clear();
+            r = a;
+            return;
         }
-        else
+
+        if (b.size() == 1)
         {
-            temp.is_negative = true;
+            q = a;
+            limb_t rem = div_small(q, b[0]);
+            r.assign(rem ? 1 : 0, rem);
+            return;
         }
-        
-        return temp;
-    }
-
-    int lint::operator[](size_t index) const
-    {
-        return numbers[index];
-    }
 
-    lint& lint::operator=(const lint& other)
-    {
-        if (this != &other)
+        if (b.size() >= newton_division_threshold && a.size() - b.size() >= newton_division_threshold)
         {
-            numbers = other.numbers;
-            is_negative = other.is_negative_number();
+            divmod_newton(a, b, q, r);
+            return;
         }
-        return *this;
-    }
-
-    lint& lint::operator++()
-    {
-        lint one(1);
-        (*this) += one;
-        return *this;
-    }
-
-    lint lint::operator++(int) {
-        lint tmp(*this);
-        operator++();
-        return tmp;
-    }
-
-    lint& lint::operator--()
-    {
-        lint one(1);
-        (*this) -= one;
-        return *this;
-    }
 
-    lint lint::operator--(int) {
-        lint tmp(*this);
-        operator--();
-        return tmp;
+        divmod_knuth(a, b, q, r);
     }
 
-    bool lint::cmp(lint const& rhs) const
+    // Knuth, TAOCP vol. 2, 4.3.1, Algorithm D on base 10^9 limbs, requires
+    // |a| >= |b| and at least two limbs in b.
+    void lint::divmod_knuth(limb_vector const& a, limb_vector const& b, limb_vector& q, limb_vector& r)
     {
-        if (is_negative_number() && !rhs.is_negative_number())
-        {
-            return true;
-        }
+        const size_t n = a.size();
+        const size_t m = b.size();
 
-        if (!is_negative_number() && rhs.is_negative_number())
-        {
-            return false;
-        }
+        // Normalize so that the top limb of the divisor is at least BASE / 2.
+        const limb_t d = BASE / (b.back() + 1);
+        limb_vector u = a;
+        limb_vector v = b;
+        mul_small(u, d);
+        mul_small(v, d);
+        u.resize(n + 1, 0);
 
-        if (get_length() < rhs.get_length())
-        {
-            return true;
-        }
+        q.assign(n - m + 1, 0);
 
-        if (get_length() > rhs.get_length())
+        for (size_t j = n - m + 1; j-- > 0;)
         {
-            return false;
-        }
+            dlimb_t numerator = static_cast<dlimb_t>(u[j + m]) * BASE + u[j + m - 1];
+            dlimb_t qhat = numerator / v[m - 1];
+            dlimb_t rhat = numerator % v[m - 1];
 
-        for (int i = 0; i < get_length(); ++i)
-        {
-            if (numbers[i] < rhs[i])
+            while (qhat >= BASE || qhat * v[m - 2] > rhat * BASE + u[j + m - 2])
             {
-                if (is_negative_number())
+                --qhat;
+                rhat += v[m - 1];
+                if (rhat >= BASE)
                 {
-                    return false;
+                    break;
                 }
-                return true;
             }
-            else if (numbers[i] > rhs[i])
+
+            // u[j .. j + m] -= qhat * v
+            dlimb_t carry = 0;
+            int64_t borrow = 0;
+            for (size_t i = 0; i < m; ++i)
+            {
+                dlimb_t product = qhat * v[i] + carry;
+                carry = product / BASE;
+                int64_t t = static_cast<int64_t>(u[i + j]) - static_cast<int64_t>(product % BASE) - borrow;
+                borrow = t < 0;
+                u[i + j] = static_cast<limb_t>(t < 0 ? t + BASE : t);
+            }
+            int64_t top = static_cast<int64_t>(u[j + m]) - static_cast<int64_t>(carry) - borrow;
+
+            if (top < 0)
             {
-                if (is_negative_number())
+                // qhat was one too large, add the divisor back
+                --qhat;
+                limb_t add_carry = 0;
+                for (size_t i = 0; i < m; ++i)
                 {
-                    return true;
+                    limb_t sum = u[i + j] + v[i] + add_carry;
+                    add_carry = sum >= BASE;
+                    u[i + j] = add_carry ? sum - BASE : sum;
                 }
-                return false;
+                top += add_carry;
             }
+
+            u[j + m] = static_cast<limb_t>(top);
+            q[j] = static_cast<limb_t>(qhat);
+        }
+
+        while (!q.empty() && q.back() == 0)
+        {
+            q.pop_back();
         }
 
-        return false;
+        u.resize(m);
+        div_small(u, d);
+        r = std::move(u);
     }
 
-    int lint::compare(lint const& rhs) const
+    // Long division in blocks of m = |b| limbs, each block divided by
+    // multiplying with the reciprocal floor(BASE^(2m) / b).
+    void lint::divmod_newton(limb_vector const& a, limb_vector const& b, limb_vector& q, limb_vector& r)
     {
-        if ((*this).cmp(rhs))
-        {
-            return -1;
-        }
-        else if (rhs.cmp(*this))
+        const size_t n = a.size();
+        const size_t m = b.size();
+
+        lint divisor;
+        divisor.limbs = b;
+        const lint inverse = reciprocal(divisor);
+
+        q.assign(n, 0);
+        lint remainder;
+
+        for (size_t block = (n + m - 1) / m; block-- > 0;)
         {
-            return 1;
+            // current = remainder * BASE^m + block, which is below b * BASE^m
+            lint current = remainder;
+            current.limbs.insert(current.limbs.begin(), m, 0);
+            add_at(current.limbs, limb_vector(a.begin() + block * m, a.begin() + std::min(n, block * m + m)), 0);
+            current.trim();
+
+            lint quotient = current * inverse;
+            quotient.limbs.erase(quotient.limbs.begin(), quotient.limbs.begin() + std::min(2 * m, quotient.limbs.size()));
+
+            remainder = current - quotient * divisor;
+            while (remainder >= divisor)
+            {
+                ++quotient;
+                remainder -= divisor;
+            }
+
+            std::copy(quotient.limbs.begin(), quotient.limbs.end(), q.begin() + block * m);
         }
-        else
+
+        while (!q.empty() && q.back() == 0)
         {
-            return 0;
+            q.pop_back();
         }
-    }
 
-    lint lint::abs(lint number) const
-    {
-        number.is_negative = false;
-        return number;
+        r = std::move(remainder.limbs);
     }
 
-    bool lint::is_zero() const
+    // floor(BASE^(2m) / b) for an m limb divisor b. The top half of b (plus
+    // two guard limbs) gives a reciprocal with half the precision, one Newton
+    // step x += x (BASE^(2m) - b x) / BASE^(2m) doubles it and the few
+    // remaining units of error are corrected exactly.
+    lint lint::reciprocal(lint const& b)
     {
-        if (numbers.size() == 1 && numbers[0] == 0)
+        const size_t m = b.limbs.size();
+
+        lint power;
+        power.limbs.assign(2 * m, 0);
+        power.limbs.push_back(1);
+
+        // Below the Karatsuba threshold Newton cannot beat algorithm D.
+        if (m <= std::max<size_t>(karatsuba_threshold, 8))
         {
-            return true;
+            lint remainder;
+            divmod_knuth(power.limbs, b.limbs, power.limbs, remainder.limbs);
+            return power;
         }
 
-        return false;
-    }
-
-    std::string int_to_string(int i)
-    {
-        std::stringstream ss;
-        std::string s;
-        ss << i;
-        s = ss.str();
+        const size_t h = (m + 1) / 2 + 2;
+        lint top;
+        top.limbs.assign(b.limbs.end() - h, b.limbs.end());
 
-        return s;
-    }
+        lint x = reciprocal(top);
+        x.limbs.insert(x.limbs.begin(), m - h, 0);
 
-    std::string lint::to_string()
-    {
-        std::string result = "";
+        lint error = power - b * x;
+        lint step = x * error;
+        step.limbs.erase(step.limbs.begin(), step.limbs.begin() + std::min(2 * m, step.limbs.size()));
+        step.trim();
+        x += step;
 
-        if (is_negative_number() && !is_zero())
+        error = power - b * x;
+        while (error.is_negative)
         {
-            result += "-";
+            --x;
+            error += b;
         }
-
-        for (int i = 0; i < get_length(); ++i)
+        while (error >= b)
         {
-            int a = (*this)[i];
-            result += int_to_string(a);
+            ++x;
+            error -= b;
         }
 
-        return result;
+        return x;
     }
 
-    vector<int> lint::reverse_numbers(vector<int> const& numbers) const
+    // a += b * BASE^offset, a must already be long enough to hold the sum
+    void lint::add_at(limb_vector& a, limb_vector const& b, size_t offset)
     {
-        vector<int> reverse_result;
+        limb_t carry = 0;
+        size_t i = 0;
 
-        for (int i = numbers.size() - 1; i >= 0; --i)
+        for (; i < b.size(); ++i)
         {
-            reverse_result.push_back(numbers[i]);
+            limb_t sum = a[offset + i] + b[i] + carry;
+            carry = sum >= BASE;
+            a[offset + i] = carry ? sum - BASE : sum;
         }
 
-        return reverse_result;
+        for (; carry; ++i)
+        {
+            limb_t sum = a[offset + i] + carry;
+            carry = sum >= BASE;
+            a[offset + i] = carry ? sum - BASE : sum;
+        }
     }
 
-    void lint::make_equal_length(lint const& b, vector<int>& number1, vector<int>& number2) const
+    // a /= d for a single limb d, returns the remainder
+    lint::limb_t lint::div_small(limb_vector& a, limb_t d)
     {
-        int diff_length = get_length() - b.get_length();
+        dlimb_t rem = 0;
 
-        if (diff_length > 0)
+        for (size_t i = a.size(); i-- > 0;)
         {
-            number1 = (*this).numbers;
-
-            for (int i = 0; i < diff_length; ++i)
-            {
-                number2.push_back(0);
-            }
+            dlimb_t cur = a[i] + rem * BASE;
+            a[i] = static_cast<limb_t>(cur / d);
+            rem = cur % d;
+        }
 
-            for (int i = 0; i < b.get_length(); ++i)
-            {
-                number2.push_back(b[i]);
-            }
+        while (!a.empty() && a.back() == 0)
+        {
+            a.pop_back();
         }
-        else if (diff_length < 0)
+
+        return static_cast<limb_t>(rem);
+    }
+
+    // a *= m for a single limb m < BASE
+    void lint::mul_small(limb_vector& a, limb_t m)
+    {
+        if (m == 0)
         {
-            for (int i = 0; i < b.get_length(); ++i)
-            {
-                number2.push_back(b[i]);
-            }
+            a.clear();
+            return;
+        }
 
-            for (int i = 0; i < (diff_length * (-1)); ++i)
-            {
-                number1.push_back(0);
-            }
+        dlimb_t carry = 0;
 
-            for (int i = 0; i < get_length(); ++i)
-            {
-                number1.push_back((*this)[i]);
-            }
+        for (limb_t& limb : a)
+        {
+            dlimb_t cur = static_cast<dlimb_t>(limb) * m + carry;
+            limb = static_cast<limb_t>(cur % BASE);
+            carry = cur / BASE;
         }
-        else
+
+        if (carry)
         {
-            for (int i = 0; i < b.get_length(); ++i)
-            {
-                number1.push_back((*this)[i]);
-                number2.push_back(b[i]);
-            }
+            a.push_back(static_cast<limb_t>(carry));
         }
     }
 
     void lint::string_to_vector(std::string const& number)
     {
-        unsigned int from = 0;
+        size_t from = 0;
+        is_negative = false;
 
-        if (number[0] == '-')
+        if (!number.empty() && (number[0] == '-' || number[0] == '+'))
         {
-            is_negative = true;
+            is_negative = number[0] == '-';
             from = 1;
         }
-        else
+
+        size_t to = from;
+        while (to < number.size() && number[to] >= '0' && number[to] <= '9')
         {
-            is_negative = false;
+            ++to;
         }
 
-        for (unsigned int i = from; i < number.length(); ++i)
+        limbs.clear();
+        limbs.reserve((to - from) / BASE_DIGITS + 1);
+
+        for (size_t end = to; end > from;)
         {
-            int ia = number[i] - '0';
-            numbers.push_back(ia);
+            size_t begin = end >= from + BASE_DIGITS ? end - BASE_DIGITS : from;
+            limb_t limb = 0;
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                limb = limb * 10 + static_cast<limb_t>(number[i] - '0');
+            }
+
+            limbs.push_back(limb);
+            end = begin;
         }
+
+        trim();
     }
 
     void lint::integer_to_vector(long long a)
     {
-        if (a < 0)
-        {
-            is_negative = true;
-            a = (-1) * a;
-        }
-        else
-        {
-            is_negative = false;
-        }
-
-        if (a == 0)
-        {
-            numbers.push_back(0);
-        }
+        is_negative = a < 0;
 
-        vector<int> temp;
+        unsigned long long magnitude = is_negative
+            ? 0ull - static_cast<unsigned long long>(a)
+            : static_cast<unsigned long long>(a);
 
-        while (a)
-        {
-            int x = a % 10;
-            a /= 10;
-            temp.push_back(x);
-        }
+        limbs.clear();
 
-        for (int i = temp.size() - 1; i >= 0; --i)
+        while (magnitude)
         {
-            numbers.push_back(temp[i]);
+            limbs.push_back(static_cast<limb_t>(magnitude % BASE));
+            magnitude /= BASE;
         }
     }
 
     lint abs(lint number)
     {
-        lint n(number);
-        lint zero(0);
-
-        bool is_less = n.cmp(zero);
-
-        if (is_less)
+        if (number.is_negative_number())
         {
-            n *= lint(-1);
+            return -number;
         }
-        return n;
+        return number;
     }
 
     lint pow(lint a, int n) {
@@ -686,71 +1292,95 @@ namespace apa
         return res;
     }
 
+    lint sqr(const lint& a)
+    {
+        lint res(a);
+        res *= res;
+        return res;
+    }
+
+    // Digits are formatted into a fixed stack buffer and handed to the
+    // stream in large blocks, no intermediate string is built.
     std::ostream& operator<<(std::ostream& os, const lint& obj)
     {
+        const lint::limb_vector& limbs = obj.get_limbs();
+
+        if (limbs.empty())
+        {
+            return os << '0';
+        }
+
+        const size_t BUFFER_LIMBS = 512;
+        char buffer[BUFFER_LIMBS * lint::BASE_DIGITS + 1];
+        char* out = buffer;
+
         if (obj.is_negative_number())
         {
-            os << "-";
+            *out++ = '-';
         }
 
-        for (int i = 0; i < obj.get_length(); ++i)
+        out = format_limb(out, limbs.back(), limb_digits(limbs.back()));
+
+        for (size_t i = limbs.size() - 1; i-- > 0;)
         {
-            os << obj[i];
+            if (out + lint::BASE_DIGITS > buffer + sizeof(buffer))
+            {
+                os.write(buffer, out - buffer);
+                out = buffer;
+            }
+            out = format_limb(out, limbs[i], lint::BASE_DIGITS);
         }
 
+        os.write(buffer, out - buffer);
+
         return os;
     }
 
+    // Reads one line, reading through the stream buffer instead of a
+    // formatted get() per character.
     std::istream& operator>>(std::istream& is, lint& obj)
     {
         bool is_lead_zeros = true;
         bool is_negative = false;
-        vector<int> numbers;
+        std::string digits;
+        std::streambuf* buffer = is.rdbuf();
 
-        while (is.good())
+        while (true)
         {
-            char c = static_cast<char>(is.get());
-            int ic = c - '0';
+            const int c = buffer->sbumpc();
 
-            if (c == '\n')
+            if (c == std::char_traits<char>::eof())
             {
+                is.setstate(std::ios::eofbit);
                 break;
             }
 
-            if (c == EOF)
+            if (c == '\n' || c == '\0')
             {
                 break;
             }
 
-            if (c == '\0')
+            if (c == '-')
             {
-                break;
+                is_negative = true;
             }
-
-            if (is.good())
+            else if (c == '+')
+            {
+                is_negative = false;
+            }
+            else if (c == '0' && is_lead_zeros)
             {
-                if (c == '-')
-                {
-                    is_negative = true;
-                }
-                else if (c == '+')
-                {
-                    is_negative = false;
-                }
-                else if (ic == 0 && is_lead_zeros)
-                {
 
-                }
-                else
-                {
-                    numbers.push_back(ic);
-                    is_lead_zeros = false;
-                }
+            }
+            else if (c >= '0' && c <= '9')
+            {
+                digits.push_back(static_cast<char>(c));
+                is_lead_zeros = false;
             }
         }
 
-        lint temp(numbers, is_negative);
-        obj = temp;
+        lint temp(digits);
+        obj = is_negative ? -temp : temp;
 
         return is;
     }
@@ -758,28 +1388,75 @@ namespace apa
     lint operator+(const lint& lhs, const lint& rhs)
     {
         lint temp(lhs);
+        temp += rhs;
+
+        return temp;
+    }
+
+    lint operator+(lint&& lhs, const lint& rhs)
+    {
+        lhs += rhs;
 
-        return temp += rhs;
+        return std::move(lhs);
     }
 
     lint operator-(const lint& lhs, const lint& rhs)
     {
         lint temp(lhs);
+        temp -= rhs;
+
+        return temp;
+    }
+
+    lint operator-(lint&& lhs, const lint& rhs)
+    {
+        lhs -= rhs;
 
-        return temp -= rhs;
+        return std::move(lhs);
     }
 
     lint operator*(const lint& lhs, const lint& rhs)
     {
         lint temp(lhs);
+        temp *= rhs;
+
+        return temp;
+    }
+
+    lint operator*(lint&& lhs, const lint& rhs)
+    {
+        lhs *= rhs;
 
-        return temp *= rhs;
+        return std::move(lhs);
     }
 
     lint operator/(const lint& lhs, const lint& rhs)
     {
         lint temp(lhs);
+        temp /= rhs;
+
+        return temp;
+    }
+
+    lint operator/(lint&& lhs, const lint& rhs)
+    {
+        lhs /= rhs;
+
+        return std::move(lhs);
+    }
+
+    lint operator%(const lint& lhs, const lint& rhs)
+    {
+        lint temp(lhs);
+        temp %= rhs;
+
+        return temp;
+    }
+
+    lint operator%(lint&& lhs, const lint& rhs)
+    {
+        lhs %= rhs;
 
-        return temp /= rhs;
+        return std::move(lhs);
     }
-}
\ No newline at end of file
+}
@@ -5,6 +5,11 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include "small_vector.hpp"
 
 namespace apa
 {
@@ -45,9 +50,38 @@ namespace apa
         }
     };
 
+    // Arbitrary precision integer. Magnitude is stored in base 10^9 limbs,
+    // least significant limb first, without leading zero limbs (zero is an
+    // empty limb vector and is never negative).
     class lint : ComparisonOperators<lint>
     {
     public:
+        using limb_t = uint32_t;
+        using dlimb_t = uint64_t;
+
+        static constexpr limb_t BASE = 1000000000;
+        static constexpr int BASE_DIGITS = 9;
+
+        // Up to 6 limbs (54 decimal digits, more than 128 bits) are stored
+        // inside the object without a heap allocation.
+        static constexpr size_t INLINE_LIMBS = 6;
+        using limb_vector = small_vector<limb_t, INLINE_LIMBS>;
+
+        // Operand sizes (in limbs of the shorter factor) from which
+        // operator*= switches from schoolbook to Karatsuba, Toom-3 and the
+        // three-prime number theoretic transform.
+        static inline size_t karatsuba_threshold = 40;
+        static inline size_t toom3_threshold = 256;
+        static inline size_t ntt_threshold = 768;
+
+        // Longest product (in limbs) the NTT can produce; longer products
+        // are split by Toom-3 first.
+        static constexpr size_t NTT_MAX_LENGTH = size_t(1) << 24;
+
+        // Divisor and quotient size (in limbs) from which division switches
+        // from Knuth's algorithm D to multiplication by a Newton reciprocal.
+        static inline size_t newton_division_threshold = 1800;
+
         explicit lint(std::string number);
 
         lint();
@@ -62,10 +96,14 @@ namespace apa
 
         lint(const lint &obj);
 
+        lint(lint&& obj) noexcept;
+
         int get_length() const;
 
         bool is_negative_number() const;
 
+        const limb_vector& get_limbs() const;
+
         lint& operator+=(const lint& b);
 
         lint& operator-=(const lint& b);
@@ -74,6 +112,11 @@ namespace apa
 
         lint& operator/=(const lint& b);
 
+        lint& operator%=(const lint& b);
+
+        // Quotient truncated towards zero and remainder with the sign of a.
+        friend std::pair<lint, lint> divmod(const lint& a, const lint& b);
+
         explicit operator bool() const;
 
         explicit operator int();
@@ -86,6 +129,8 @@ namespace apa
 
         lint& operator=(const lint& other);
 
+        lint& operator=(lint&& other) noexcept;
+
         lint& operator++();
 
         lint operator++(int);
@@ -98,19 +143,68 @@ namespace apa
 
         int compare(lint const& rhs) const;
 
+        // Compares |*this| with |rhs| without materializing either absolute value.
+        int compare_abs(lint const& rhs) const;
+
+        // dst = a + b and dst = a - b reusing the capacity of dst, any of the
+        // three may alias each other.
+        friend void add_to(lint& dst, const lint& a, const lint& b);
+
+        friend void sub_to(lint& dst, const lint& a, const lint& b);
+
         bool is_zero() const;
 
-        std::string to_string();
+        std::string to_string() const;
 
     private:
         bool is_negative;
-        vector<int> numbers;
+        limb_vector limbs;
 
         lint abs(lint number) const;
 
-        vector<int> reverse_numbers(vector<int> const& numbers) const;
+        void trim();
+
+        static int compare_abs(limb_vector const& a, limb_vector const& b);
+
+        static void add_abs(limb_vector& a, limb_vector const& b);
+
+        static void add_signed(lint& dst, const lint& a, const lint& b, bool negate_b);
+
+        static void add_abs_to(limb_vector& dst, limb_vector const& a, limb_vector const& b);
+
+        static void sub_abs_to(limb_vector& dst, limb_vector const& a, limb_vector const& b);
+
+        static void increment_abs(limb_vector& a);
+
+        static void decrement_abs(limb_vector& a);
+
+        static void sub_abs(limb_vector& a, limb_vector const& b);
 
-        void make_equal_length(const lint& b, vector<int> & number1, vector<int> & number2) const;
+        static limb_vector mul_abs(limb_vector const& a, limb_vector const& b);
+
+        static limb_vector mul_limbs(const limb_t* a, size_t n, const limb_t* b, size_t m);
+
+        static limb_vector mul_schoolbook(const limb_t* a, size_t n, const limb_t* b, size_t m);
+
+        static limb_vector mul_karatsuba(const limb_t* a, size_t n, const limb_t* b, size_t m);
+
+        static limb_vector mul_toom3(const limb_t* a, size_t n, const limb_t* b, size_t m);
+
+        static limb_vector mul_ntt(const limb_t* a, size_t n, const limb_t* b, size_t m);
+
+        static void add_at(limb_vector& a, limb_vector const& b, size_t offset);
+
+        static void divmod_abs(limb_vector const& a, limb_vector const& b, limb_vector& q, limb_vector& r);
+
+        static void divmod_knuth(limb_vector const& a, limb_vector const& b, limb_vector& q, limb_vector& r);
+
+        static void divmod_newton(limb_vector const& a, limb_vector const& b, limb_vector& q, limb_vector& r);
+
+        static lint reciprocal(lint const& b);
+
+        static limb_t div_small(limb_vector& a, limb_t d);
+
+        static void mul_small(limb_vector& a, limb_t m);
 
         void string_to_vector(std::string const& number);
 
@@ -121,6 +215,14 @@ namespace apa
 
     lint pow(lint a, int n);
 
+    lint sqr(const lint& a);
+
+    std::pair<lint, lint> divmod(const lint& a, const lint& b);
+
+    void add_to(lint& dst, const lint& a, const lint& b);
+
+    void sub_to(lint& dst, const lint& a, const lint& b);
+
     std::ostream& operator<<(std::ostream& os, const lint& obj);
 
     std::istream& operator>>(std::istream& is, lint& obj);
@@ -132,6 +234,18 @@ namespace apa
     lint operator*(const lint& lhs, const lint& rhs);
 
     lint operator/(const lint& lhs, const lint& rhs);
+
+    lint operator+(lint&& lhs, const lint& rhs);
+
+    lint operator-(lint&& lhs, const lint& rhs);
+
+    lint operator*(lint&& lhs, const lint& rhs);
+
+    lint operator/(lint&& lhs, const lint& rhs);
+
+    lint operator%(const lint& lhs, const lint& rhs);
+
+    lint operator%(lint&& lhs, const lint& rhs);
 }
 
 #endif /* LINT */
\ No newline at end of file
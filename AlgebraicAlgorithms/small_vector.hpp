@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+namespace apa
+{
+    // Vector of trivially copyable values that keeps up to N elements inside
+    // the object and only moves them to the heap once it grows past N.
+    // Covers the part of the std::vector interface lint needs.
+    template <typename T, size_t N>
+    class small_vector
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "small_vector stores trivially copyable types only");
+
+    public:
+        using value_type = T;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        small_vector()
+        {
+        }
+
+        explicit small_vector(size_t count)
+        {
+            assign(count, T());
+        }
+
+        small_vector(size_t count, T value)
+        {
+            assign(count, value);
+        }
+
+        template <typename It, typename = std::enable_if_t<!std::is_integral_v<It>>>
+        small_vector(It first, It last)
+        {
+            assign(first, last);
+        }
+
+        small_vector(const small_vector& other)
+        {
+            assign(other.begin(), other.end());
+        }
+
+        small_vector(small_vector&& other) noexcept
+        {
+            steal(other);
+        }
+
+        ~small_vector()
+        {
+            release();
+        }
+
+        small_vector& operator=(const small_vector& other)
+        {
+            if (this != &other)
+            {
+                assign(other.begin(), other.end());
+            }
+            return *this;
+        }
+
+        small_vector& operator=(small_vector&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                steal(other);
+            }
+            return *this;
+        }
+
+        T* data()
+        {
+            return is_inline() ? inline_ : heap_;
+        }
+
+        const T* data() const
+        {
+            return is_inline() ? inline_ : heap_;
+        }
+
+        iterator begin()
+        {
+            return data();
+        }
+
+        iterator end()
+        {
+            return data() + size_;
+        }
+
+        const_iterator begin() const
+        {
+            return data();
+        }
+
+        const_iterator end() const
+        {
+            return data() + size_;
+        }
+
+        size_t size() const
+        {
+            return size_;
+        }
+
+        size_t capacity() const
+        {
+            return capacity_;
+        }
+
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+
+        bool is_inline() const
+        {
+            return capacity_ == N;
+        }
+
+        T& operator[](size_t index)
+        {
+            return data()[index];
+        }
+
+        const T& operator[](size_t index) const
+        {
+            return data()[index];
+        }
+
+        T& back()
+        {
+            return data()[size_ - 1];
+        }
+
+        const T& back() const
+        {
+            return data()[size_ - 1];
+        }
+
+        void reserve(size_t new_capacity)
+        {
+            if (new_capacity <= capacity_)
+            {
+                return;
+            }
+
+            T* memory = static_cast<T*>(std::malloc(new_capacity * sizeof(T)));
+            if (memory == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            if (size_)
+            {
+                std::memcpy(memory, data(), size_ * sizeof(T));
+            }
+            if (!is_inline())
+            {
+                std::free(heap_);
+            }
+            heap_ = memory;
+            capacity_ = new_capacity;
+        }
+
+        void push_back(T value)
+        {
+            if (size_ == capacity_)
+            {
+                reserve(capacity_ * 2);
+            }
+            data()[size_++] = value;
+        }
+
+        void pop_back()
+        {
+            --size_;
+        }
+
+        void clear()
+        {
+            size_ = 0;
+        }
+
+        void resize(size_t count)
+        {
+            resize(count, T());
+        }
+
+        void resize(size_t count, T value)
+        {
+            if (count > size_)
+            {
+                grow_to(count);
+                std::fill(data() + size_, data() + count, value);
+            }
+            size_ = count;
+        }
+
+        void assign(size_t count, T value)
+        {
+            size_ = 0;
+            resize(count, value);
+        }
+
+        template <typename It, typename = std::enable_if_t<!std::is_integral_v<It>>>
+        void assign(It first, It last)
+        {
+            const size_t count = static_cast<size_t>(std::distance(first, last));
+            size_ = 0;
+            grow_to(count);
+            std::copy(first, last, data());
+            size_ = count;
+        }
+
+        iterator insert(const_iterator position, size_t count, T value)
+        {
+            const size_t index = static_cast<size_t>(position - begin());
+            grow_to(size_ + count);
+            T* p = data();
+            std::memmove(p + index + count, p + index, (size_ - index) * sizeof(T));
+            std::fill(p + index, p + index + count, value);
+            size_ += count;
+            return p + index;
+        }
+
+        iterator insert(const_iterator position, T value)
+        {
+            return insert(position, 1, value);
+        }
+
+        iterator erase(const_iterator first, const_iterator last)
+        {
+            const size_t from = static_cast<size_t>(first - begin());
+            const size_t to = static_cast<size_t>(last - begin());
+            T* p = data();
+            std::memmove(p + from, p + to, (size_ - to) * sizeof(T));
+            size_ -= to - from;
+            return p + from;
+        }
+
+        void swap(small_vector& other) noexcept
+        {
+            small_vector temp(std::move(other));
+            other = std::move(*this);
+            *this = std::move(temp);
+        }
+
+    private:
+        void grow_to(size_t count)
+        {
+            if (count > capacity_)
+            {
+                reserve(std::max(count, capacity_ * 2));
+            }
+        }
+
+        void release()
+        {
+            if (!is_inline())
+            {
+                std::free(heap_);
+            }
+            size_ = 0;
+            capacity_ = N;
+        }
+
+        // Takes over the storage of other and leaves it empty and inline.
+        void steal(small_vector& other)
+        {
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            if (other.is_inline())
+            {
+                std::memcpy(inline_, other.inline_, size_ * sizeof(T));
+            }
+            else
+            {
+                heap_ = other.heap_;
+            }
+            other.size_ = 0;
+            other.capacity_ = N;
+        }
+
+        size_t size_ = 0;
+        size_t capacity_ = N;
+        union
+        {
+            T* heap_;
+            T inline_[N];
+        };
+    };
+}